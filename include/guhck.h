@@ -0,0 +1,91 @@
+#ifndef __guhck_h__
+#define __guhck_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(GUHCK_BUILD_SHARED) && (defined(__GNUC__) || defined(__clang__))
+#  define GUHCK_API __attribute__((visibility("default")))
+#else
+#  define GUHCK_API
+#endif
+
+/**
+ * .hack//G.U CCS archive reader.
+ * Everything handed to callbacks is owned by the archive and only valid
+ * for the duration of the callback. Names are NULL when the archive has none.
+ */
+struct guhck_archive;
+
+struct guhck_palette {
+   const char *name;
+   uint32_t num_colors;
+   const uint8_t *colors; // RGBA quads
+};
+
+struct guhck_image {
+   const char *name;
+   uint32_t width, height;
+   uint32_t bpp; // 8, or 4 with two indices per byte, low nibble first
+   const uint8_t *indices;
+   uint32_t num_palettes;
+   const struct guhck_palette *palettes;
+};
+
+/** Indexed triangle list, built from the archive's triangle strips. */
+struct guhck_mesh {
+   const char *name;
+   const char *material;
+   const char *texture; // image name of the material
+   uint32_t num_vertices, num_triangles;
+   const float *positions; // xyz per vertex
+   const float *coords; // uv per vertex
+   const uint32_t *indices; // 3 per triangle
+};
+
+/** Return false to stop, NULL callbacks skip decoding of that kind entirely. */
+struct guhck_callbacks {
+   bool (*mesh)(const struct guhck_mesh *mesh, void *userdata);
+   bool (*image)(const struct guhck_image *image, void *userdata);
+   void *userdata;
+};
+
+/**
+ * Open archive from memory, gzip compressed archives are inflated.
+ * Uncompressed archives are read in place, data must outlive the archive.
+ * Returns NULL if data isn't a CCS archive or on allocation failure.
+ */
+GUHCK_API struct guhck_archive* guhck_archive_open_memory(const void *data, size_t size);
+
+/** Open archive from file, same as guhck_archive_open_memory otherwise. */
+GUHCK_API struct guhck_archive* guhck_archive_open(const char *path);
+
+GUHCK_API void guhck_archive_close(struct guhck_archive *archive);
+
+GUHCK_API const char* guhck_archive_name(const struct guhck_archive *archive);
+
+/**
+ * Decode meshes and images and hand them to callbacks in archive order, meshes first.
+ * Returns false on decoding or allocation failure, stopping from a callback is not a failure.
+ */
+GUHCK_API bool guhck_archive_decode(struct guhck_archive *archive, const struct guhck_callbacks *callbacks);
+
+/**
+ * Expand image with the given palette to width * height RGBA pixels,
+ * rows in the same order as guhck's PNG output.
+ * Indices outside the palette become transparent black.
+ */
+GUHCK_API bool guhck_image_rgba(const struct guhck_image *image, uint32_t palette, uint8_t *rgba);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __guhck_h__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
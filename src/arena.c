@@ -0,0 +1,138 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define ARENA_ALIGN 16
+#define ARENA_BLOCK_SIZE (256 * 1024)
+
+struct arena_block {
+   struct arena_block *next;
+   size_t size, used;
+};
+
+// payload starts after the header, rounded up to the alignment
+#define ARENA_HEADER ((sizeof(struct arena_block) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_DATA(b) ((unsigned char*)(b) + ARENA_HEADER)
+
+static struct arena_block*
+block_new(struct arena *arena, size_t size)
+{
+   assert(arena);
+
+   struct arena_block *block;
+   if (size > SIZE_MAX - ARENA_HEADER || !(block = malloc(ARENA_HEADER + size)))
+      return NULL;
+
+   block->next = NULL;
+   block->size = size;
+   block->used = 0;
+   arena->num_blocks++;
+   arena->reserved += size;
+   return block;
+}
+
+void*
+arena_alloc(struct arena *arena, size_t size)
+{
+   assert(arena);
+
+   // rounding up would wrap around to a tiny allocation
+   if (size > SIZE_MAX - (ARENA_ALIGN - 1))
+      return NULL;
+
+   size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+   if (!size || size < ARENA_ALIGN)
+      size = ARENA_ALIGN;
+
+   const size_t block_size = (arena->block_size ? arena->block_size : ARENA_BLOCK_SIZE);
+
+   struct arena_block *block = arena->blocks;
+   if (!block || block->size - block->used < size) {
+      struct arena_block *next;
+      if (!(next = block_new(arena, (size > block_size / 4 ? size : block_size))))
+         return NULL;
+
+      if (block && size > block_size / 4) {
+         // big allocations get their own block, don't waste the current one
+         next->next = block->next;
+         block->next = next;
+      } else {
+         next->next = block;
+         arena->blocks = next;
+      }
+
+      block = next;
+   }
+
+   void *ptr = ARENA_DATA(block) + block->used;
+   block->used += size;
+   arena->used += size;
+   arena->num_allocs++;
+   return ptr;
+}
+
+void*
+arena_calloc(struct arena *arena, size_t nmemb, size_t size)
+{
+   assert(arena);
+
+   if (size && nmemb > SIZE_MAX / size)
+      return NULL;
+
+   void *ptr;
+   if ((ptr = arena_alloc(arena, nmemb * size)))
+      memset(ptr, 0, nmemb * size);
+   return ptr;
+}
+
+char*
+arena_strndup(struct arena *arena, const char *str, size_t len)
+{
+   assert(arena && str);
+
+   char *ptr;
+   if ((ptr = arena_alloc(arena, len + 1))) {
+      memcpy(ptr, str, len);
+      ptr[len] = 0;
+   }
+   return ptr;
+}
+
+void
+arena_reset(struct arena *arena)
+{
+   assert(arena);
+
+   struct arena_block *keep = arena->blocks;
+   if (!keep)
+      return;
+
+   for (struct arena_block *b = keep->next, *n; b; b = n) {
+      n = b->next;
+      free(b);
+   }
+
+   keep->next = NULL;
+   keep->used = 0;
+   arena->num_blocks = 1;
+   arena->reserved = keep->size;
+   arena->used = arena->num_allocs = 0;
+}
+
+void
+arena_release(struct arena *arena)
+{
+   assert(arena);
+
+   for (struct arena_block *b = arena->blocks, *n; b; b = n) {
+      n = b->next;
+      free(b);
+   }
+
+   const size_t block_size = arena->block_size;
+   memset(arena, 0, sizeof(struct arena));
+   arena->block_size = block_size;
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,29 @@
+#ifndef __guhck_arena__
+#define __guhck_arena__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Bump allocator, everything allocated from it is freed at once.
+ * Zero initialized struct is a valid empty arena.
+ */
+struct arena {
+   struct arena_block *blocks;
+   size_t block_size; // 0 for default
+   size_t num_allocs, num_blocks;
+   size_t used, reserved;
+};
+
+void* arena_alloc(struct arena *arena, size_t size);
+void* arena_calloc(struct arena *arena, size_t nmemb, size_t size);
+char* arena_strndup(struct arena *arena, const char *str, size_t len);
+
+/** Free everything but keep one block around for reuse. */
+void arena_reset(struct arena *arena);
+void arena_release(struct arena *arena);
+
+#endif /* __guhck_arena__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,212 @@
+#include "atlas.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+struct skyline_node {
+   uint32_t x, y, width;
+};
+
+/**
+ * Top edge of everything packed so far, as runs of equal height.
+ * Nodes are sorted by x and cover the whole page width.
+ */
+struct skyline {
+   struct skyline_node *nodes;
+   uint32_t num_nodes;
+   uint32_t used_width, used_height;
+};
+
+static bool
+skyline_fit(const struct skyline *skyline, uint32_t size, uint32_t i, uint32_t width, uint32_t height, uint32_t *out_y)
+{
+   assert(skyline && out_y);
+
+   if (skyline->nodes[i].x + width > size)
+      return false;
+
+   // rect rests on the highest node below it
+   uint32_t y = 0;
+   for (uint32_t left = width; left > 0 && i < skyline->num_nodes; ++i) {
+      if (skyline->nodes[i].y > y)
+         y = skyline->nodes[i].y;
+
+      if (y + height > size)
+         return false;
+
+      left = (skyline->nodes[i].width >= left ? 0 : left - skyline->nodes[i].width);
+   }
+
+   *out_y = y;
+   return true;
+}
+
+static bool
+skyline_insert(struct skyline *skyline, uint32_t size, uint32_t width, uint32_t height, uint32_t *out_x, uint32_t *out_y)
+{
+   assert(skyline && out_x && out_y);
+
+   // bottom-left: lowest top edge, then leftmost
+   uint32_t best = UINT32_MAX, best_y = 0;
+   for (uint32_t i = 0; i < skyline->num_nodes; ++i) {
+      uint32_t y;
+      if (!skyline_fit(skyline, size, i, width, height, &y))
+         continue;
+
+      if (best == UINT32_MAX || y < best_y) {
+         best = i;
+         best_y = y;
+      }
+   }
+
+   if (best == UINT32_MAX)
+      return false;
+
+   struct skyline_node *nodes = skyline->nodes;
+   const uint32_t x = nodes[best].x;
+   memmove(&nodes[best + 1], &nodes[best], (skyline->num_nodes - best) * sizeof(struct skyline_node));
+   nodes[best] = (struct skyline_node){ x, best_y + height, width };
+   skyline->num_nodes++;
+
+   // trim the nodes the new one now covers
+   for (uint32_t i = best + 1; i < skyline->num_nodes;) {
+      const uint32_t end = nodes[i - 1].x + nodes[i - 1].width;
+      if (nodes[i].x >= end)
+         break;
+
+      const uint32_t shrink = end - nodes[i].x;
+      if (nodes[i].width > shrink) {
+         nodes[i].x += shrink;
+         nodes[i].width -= shrink;
+         break;
+      }
+
+      memmove(&nodes[i], &nodes[i + 1], (skyline->num_nodes - i - 1) * sizeof(struct skyline_node));
+      skyline->num_nodes--;
+   }
+
+   // merge runs of equal height
+   for (uint32_t i = 0; i + 1 < skyline->num_nodes;) {
+      if (nodes[i].y != nodes[i + 1].y) {
+         ++i;
+         continue;
+      }
+
+      nodes[i].width += nodes[i + 1].width;
+      memmove(&nodes[i + 1], &nodes[i + 2], (skyline->num_nodes - i - 2) * sizeof(struct skyline_node));
+      skyline->num_nodes--;
+   }
+
+   if (x + width > skyline->used_width)
+      skyline->used_width = x + width;
+   if (best_y + height > skyline->used_height)
+      skyline->used_height = best_y + height;
+
+   *out_x = x;
+   *out_y = best_y;
+   return true;
+}
+
+static uint32_t
+next_pow2(uint32_t v)
+{
+   uint32_t p = 1;
+   while (p < v)
+      p <<= 1;
+   return p;
+}
+
+struct rect_order {
+   uint32_t width, height, index;
+};
+
+static int
+rect_cmp(const void *a, const void *b)
+{
+   const struct rect_order *ra = a, *rb = b;
+   if (ra->height != rb->height)
+      return (ra->height > rb->height ? -1 : 1);
+   if (ra->width != rb->width)
+      return (ra->width > rb->width ? -1 : 1);
+   return (ra->index < rb->index ? -1 : 1);
+}
+
+bool
+atlas_pack(struct atlas_rect *rects, uint32_t num_rects, uint32_t max_size, struct atlas_page **out_pages, uint32_t *out_num_pages)
+{
+   assert((rects || !num_rects) && max_size && out_pages && out_num_pages);
+
+   *out_pages = NULL;
+   *out_num_pages = 0;
+
+   bool ret = false;
+   uint32_t num_skylines = 0;
+   struct rect_order *order = NULL;
+   struct skyline *skylines = NULL;
+   struct atlas_page *pages = NULL;
+   if (!num_rects ||
+       !(order = malloc(num_rects * sizeof(struct rect_order))) ||
+       !(skylines = calloc(num_rects, sizeof(struct skyline))))
+      goto out;
+
+   for (uint32_t i = 0; i < num_rects; ++i)
+      order[i] = (struct rect_order){ rects[i].width, rects[i].height, i };
+
+   qsort(order, num_rects, sizeof(struct rect_order), rect_cmp);
+
+   for (uint32_t o = 0; o < num_rects; ++o) {
+      struct atlas_rect *rect = &rects[order[o].index];
+      rect->page = ATLAS_NO_PAGE;
+      rect->x = rect->y = 0;
+
+      if (!rect->width || !rect->height || rect->width > max_size || rect->height > max_size)
+         continue;
+
+      uint32_t p;
+      for (p = 0; p < num_skylines; ++p) {
+         if (skyline_insert(&skylines[p], max_size, rect->width, rect->height, &rect->x, &rect->y))
+            break;
+      }
+
+      if (p == num_skylines) {
+         // each insert adds at most one node
+         struct skyline *skyline = &skylines[num_skylines];
+         if (!(skyline->nodes = malloc((num_rects + 2) * sizeof(struct skyline_node))))
+            goto out;
+
+         skyline->nodes[0] = (struct skyline_node){ 0, 0, max_size };
+         skyline->num_nodes = 1;
+         ++num_skylines;
+
+         if (!skyline_insert(skyline, max_size, rect->width, rect->height, &rect->x, &rect->y))
+            continue;
+      }
+
+      rect->page = p;
+   }
+
+   if (num_skylines && !(pages = calloc(num_skylines, sizeof(struct atlas_page))))
+      goto out;
+
+   for (uint32_t p = 0; p < num_skylines; ++p) {
+      const uint32_t width = next_pow2(skylines[p].used_width), height = next_pow2(skylines[p].used_height);
+      pages[p].width = (width > max_size ? max_size : width);
+      pages[p].height = (height > max_size ? max_size : height);
+   }
+
+   *out_pages = pages;
+   *out_num_pages = num_skylines;
+   ret = true;
+
+out:
+   if (!num_rects)
+      ret = true;
+
+   for (uint32_t p = 0; p < num_skylines; ++p)
+      free(skylines[p].nodes);
+   free(skylines);
+   free(order);
+   return ret;
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
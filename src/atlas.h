@@ -0,0 +1,27 @@
+#ifndef __guhck_atlas__
+#define __guhck_atlas__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ATLAS_NO_PAGE UINT32_MAX
+
+struct atlas_rect {
+   uint32_t width, height; // in
+   uint32_t x, y, page; // out, page is ATLAS_NO_PAGE if the rect is larger than a page
+};
+
+struct atlas_page {
+   uint32_t width, height; // power of two bounds of the packed rects, at most max_size
+};
+
+/**
+ * Pack rects into as few pages of at most max_size x max_size as a
+ * skyline bottom-left packer manages, largest rects first.
+ * Pages are allocated with malloc and stored to out_pages.
+ */
+bool atlas_pack(struct atlas_rect *rects, uint32_t num_rects, uint32_t max_size, struct atlas_page **out_pages, uint32_t *out_num_pages);
+
+#endif /* __guhck_atlas__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,691 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <chck/buffer/buffer.h>
+#include "ccs.h"
+#include "export.h"
+#include "mesh.h"
+
+struct bench_config {
+   uint32_t meshes, vertices;
+   uint32_t images, exponent;
+   uint32_t bpp; // 4, 8 or 0 for alternating
+   bool gzip;
+   bool png_palette;
+   uint32_t iterations;
+   uint32_t seed;
+};
+
+struct bench_buf {
+   uint8_t *data;
+   size_t len, mem;
+   bool error;
+};
+
+/**
+ * Stage timings, rates are computed from the fastest iteration.
+ * bytes is the uncompressed archive size for input, parse and decode stages,
+ * decoded float data for trimesh, RGBA pixels for png and file bytes for obj.
+ */
+struct bench_stage {
+   const char *name;
+   double min, sum;
+   uint32_t runs;
+   uint64_t bytes, items;
+};
+
+enum {
+   STAGE_INPUT,
+   STAGE_PARSE,
+   STAGE_DECODE,
+   STAGE_TRIMESH,
+   STAGE_PNG,
+   STAGE_OBJ,
+   STAGE_TOTAL,
+   STAGE_LAST,
+};
+
+static double
+now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+stage_add(struct bench_stage *stage, double start)
+{
+   assert(stage);
+   const double t = now() - start;
+   stage->min = (!stage->runs || t < stage->min ? t : stage->min);
+   stage->sum += t;
+   ++stage->runs;
+}
+
+static uint32_t
+rng_next(uint32_t *state)
+{
+   assert(state);
+   // xorshift32, only needs to be repeatable
+   uint32_t x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return (*state = x);
+}
+
+static uint8_t*
+buf_grow(struct bench_buf *buf, size_t size)
+{
+   assert(buf);
+
+   if (buf->len + size > buf->mem) {
+      size_t mem = (buf->mem ? buf->mem : 4096);
+      while (mem < buf->len + size)
+         mem *= 2;
+
+      uint8_t *data;
+      if (!(data = realloc(buf->data, mem))) {
+         buf->error = true;
+         return NULL;
+      }
+
+      buf->data = data;
+      buf->mem = mem;
+   }
+
+   uint8_t *ptr = buf->data + buf->len;
+   buf->len += size;
+   return ptr;
+}
+
+static void
+buf_zero(struct bench_buf *buf, size_t size)
+{
+   uint8_t *ptr;
+   if ((ptr = buf_grow(buf, size)))
+      memset(ptr, 0, size);
+}
+
+static void
+buf_bytes(struct bench_buf *buf, const void *data, size_t size)
+{
+   assert(data);
+
+   uint8_t *ptr;
+   if ((ptr = buf_grow(buf, size)))
+      memcpy(ptr, data, size);
+}
+
+static void
+buf_u32(struct bench_buf *buf, uint32_t v)
+{
+   uint8_t *ptr;
+   if (!(ptr = buf_grow(buf, 4)))
+      return;
+
+   ptr[0] = v; ptr[1] = v >> 8; ptr[2] = v >> 16; ptr[3] = v >> 24;
+}
+
+static void
+buf_u16(struct bench_buf *buf, uint16_t v)
+{
+   uint8_t *ptr;
+   if (!(ptr = buf_grow(buf, 2)))
+      return;
+
+   ptr[0] = v; ptr[1] = v >> 8;
+}
+
+static void
+buf_name(struct bench_buf *buf, const char *name)
+{
+   assert(name);
+
+   uint8_t *ptr;
+   if (!(ptr = buf_grow(buf, 32)))
+      return;
+
+   memset(ptr, 0, 32);
+   memcpy(ptr, name, strnlen(name, 31));
+}
+
+static size_t
+chunk_begin(struct bench_buf *buf, uint32_t type)
+{
+   buf_u32(buf, type);
+   buf_u32(buf, 0);
+   return buf->len;
+}
+
+static void
+chunk_end(struct bench_buf *buf, size_t start)
+{
+   while ((buf->len - start) % 4)
+      buf_zero(buf, 1);
+
+   if (buf->error)
+      return;
+
+   const uint32_t size = (buf->len - start) / 4;
+   uint8_t *ptr = buf->data + start - 4;
+   ptr[0] = size; ptr[1] = size >> 8; ptr[2] = size >> 16; ptr[3] = size >> 24;
+}
+
+static bool
+generate(struct bench_buf *buf, const struct bench_config *config)
+{
+   assert(buf && config);
+
+   // objects per asset: material, texture, palette, mesh
+   const uint32_t assets = (config->meshes > config->images ? config->meshes : config->images);
+   const uint32_t num_objects = assets * 4;
+   uint32_t rng = (config->seed ? config->seed : 1);
+
+   {
+      static const char name[] = "bench.ccs";
+      buf_u32(buf, 0xcccc0001);
+      buf_u32(buf, sizeof(name));
+      buf_bytes(buf, name, sizeof(name));
+      buf_zero(buf, 23 + 24);
+      buf_u32(buf, 1 + 1);
+      buf_u32(buf, num_objects + 1);
+      buf_zero(buf, 32);
+      buf_name(buf, "bench.tmd");
+      buf_zero(buf, 32);
+
+      char obj[32];
+      for (uint32_t i = 0; i < assets; ++i) {
+         snprintf(obj, sizeof(obj), "mat%05u", i); buf_name(buf, obj);
+         snprintf(obj, sizeof(obj), "tex%05u", i); buf_name(buf, obj);
+         snprintf(obj, sizeof(obj), "pal%05u", i); buf_name(buf, obj);
+         snprintf(obj, sizeof(obj), "mesh%05u", i); buf_name(buf, obj);
+      }
+
+      buf_zero(buf, 8);
+   }
+
+   for (uint32_t i = 0; i < assets && !buf->error; ++i) {
+      // object ids are 1 based in the archive
+      const uint32_t mat = i * 4 + 1, tex = mat + 1, pal = mat + 2, mesh = mat + 3;
+
+      if (i < config->images) {
+         const uint32_t bpp = (config->bpp ? config->bpp : (i % 2 ? 4 : 8));
+         const uint32_t num_colors = (bpp == 4 ? 16 : 256);
+
+         size_t start = chunk_begin(buf, 0xcccc0400);
+         buf_u32(buf, pal);
+         buf_zero(buf, 16);
+         for (uint32_t c = 0; c < num_colors; ++c)
+            buf_u32(buf, (rng_next(&rng) & 0x00ffffff) | (rng_next(&rng) % 129) << 24);
+         chunk_end(buf, start);
+
+         const size_t pixels = (size_t)1 << (config->exponent * 2);
+         start = chunk_begin(buf, 0xcccc0300);
+         buf_u32(buf, tex);
+         buf_u32(buf, pal);
+         buf_u32(buf, 0);
+         const uint8_t hdr[6] = { 0, (bpp == 4 ? 20 : 19), 0, 0, config->exponent, config->exponent };
+         buf_bytes(buf, hdr, sizeof(hdr));
+         buf_zero(buf, 10);
+
+         uint8_t *ptr;
+         const size_t size = (bpp == 4 ? (pixels + 1) / 2 : pixels);
+         if ((ptr = buf_grow(buf, size))) {
+            for (size_t p = 0; p < size; ++p)
+               ptr[p] = rng_next(&rng) >> 8;
+         }
+
+         // image chunks claim 200 bytes that belong to the next chunk
+         buf_zero(buf, 200);
+         chunk_end(buf, start);
+         if (!buf->error)
+            buf->len -= 200;
+      }
+
+      if (i < config->meshes) {
+         const uint32_t nv = config->vertices;
+         const size_t start = chunk_begin(buf, 0xcccc0800);
+         buf_u32(buf, mesh);
+         buf_zero(buf, 12);
+         buf_u32(buf, nv);
+         buf_u32(buf, 0);
+         buf_zero(buf, 4);
+         buf_u32(buf, 0);
+         buf_u32(buf, mat);
+         buf_u32(buf, nv);
+
+         for (uint32_t v = 0; v < nv * 3; ++v)
+            buf_u16(buf, rng_next(&rng) % 6000 - 3000);
+         buf_zero(buf, (nv * 6) % 4);
+
+         // strips of 3..18 vertices with random winding
+         for (uint32_t v = 0, left = 0; v < nv; ++v) {
+            if (!left) {
+               left = 3 + rng_next(&rng) % 16;
+               buf_u32(buf, (1 + rng_next(&rng) % 2) << 24);
+            } else {
+               buf_u32(buf, 0);
+            }
+            --left;
+         }
+
+         buf_zero(buf, nv * 4); // normals / vcolors ?
+
+         for (uint32_t v = 0; v < nv * 2; ++v)
+            buf_u16(buf, rng_next(&rng) % 256);
+
+         chunk_end(buf, start);
+      }
+   }
+
+   // a final image still needs the 200 bytes it claims past its end
+   if (config->images > config->meshes)
+      buf_zero(buf, 200);
+
+   buf_u32(buf, 0xcccc0005);
+   buf_zero(buf, 8);
+   return !buf->error;
+}
+
+static bool
+write_file(const char *path, const struct bench_buf *buf, bool gzip)
+{
+   assert(path && buf);
+
+   if (gzip) {
+      gzFile f;
+      if (!(f = gzopen(path, "wb6")))
+         return false;
+
+      bool ret = true;
+      for (size_t off = 0; off < buf->len && ret;) {
+         const unsigned len = (buf->len - off > (1 << 30) ? (1 << 30) : buf->len - off);
+         ret = (gzwrite(f, buf->data + off, len) == (int)len);
+         off += len;
+      }
+
+      return (gzclose(f) == Z_OK && ret);
+   }
+
+   FILE *f;
+   if (!(f = fopen(path, "wb")))
+      return false;
+
+   const bool ret = (fwrite(buf->data, 1, buf->len, f) == buf->len);
+   return (fclose(f) == 0 && ret);
+}
+
+static uint64_t
+file_size(const char *path)
+{
+   struct stat st;
+   return (stat(path, &st) == 0 ? (uint64_t)st.st_size : 0);
+}
+
+static void
+remove_dir(const char *path)
+{
+   assert(path);
+
+   DIR *d;
+   if (!(d = opendir(path)))
+      return;
+
+   struct dirent *e;
+   while ((e = readdir(d))) {
+      char buf[1024];
+      if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..") ||
+          snprintf(buf, sizeof(buf), "%s/%s", path, e->d_name) >= (int)sizeof(buf))
+         continue;
+      unlink(buf);
+   }
+
+   closedir(d);
+   rmdir(path);
+}
+
+struct bench_run {
+   const struct export_options *options;
+   const char *dir, *archive;
+   struct ccs_data data;
+   struct ccs_geometry *geometries;
+   struct trimesh *tris;
+   uint32_t num_geometries, num_tris;
+   struct bench_stage *stages;
+};
+
+static void
+release_trimeshes(struct bench_run *run)
+{
+   assert(run);
+   for (uint32_t i = 0; i < run->num_geometries; ++i)
+      ccs_geometry_release(&run->geometries[i]);
+   for (uint32_t i = 0; i < run->num_tris; ++i)
+      trimesh_release(&run->tris[i]);
+   run->num_geometries = run->num_tris = 0;
+}
+
+static bool
+run_iteration(struct bench_run *run, bool first)
+{
+   assert(run);
+
+   struct bench_stage *stages = run->stages;
+   const double total = now();
+
+   double start = now();
+   struct ccs_input input;
+   if (!ccs_input_open(&input, run->archive))
+      return false;
+   stage_add(&stages[STAGE_INPUT], start);
+
+   struct chck_buffer buffer;
+   if (!chck_buffer_from_pointer(&buffer, input.data, input.size, CHCK_ENDIANESS_LITTLE)) {
+      ccs_input_release(&input);
+      return false;
+   }
+
+   bool ret = false;
+   start = now();
+   if (!ccs_read_header(&buffer) || !ccs_read_index(&buffer, &run->data))
+      goto out;
+   stage_add(&stages[STAGE_PARSE], start);
+
+   const struct ccs_data *data = &run->data;
+   start = now();
+   if (!ccs_read_chunks(&buffer, &run->data, &run->options->filter))
+      goto out;
+
+   // extract decodes each mesh in its export task, timed here on its own
+   for (uint32_t i = 0; i < data->num_meshes; ++i) {
+      if (!ccs_mesh_decode(&data->meshes[i], &run->geometries[run->num_geometries]))
+         goto out;
+      ++run->num_geometries;
+   }
+   stage_add(&stages[STAGE_DECODE], start);
+
+   start = now();
+   for (uint32_t i = 0; i < data->num_meshes; ++i) {
+      const struct ccs_geometry *geometry = &run->geometries[i];
+      struct trimesh *tri = &run->tris[run->num_tris];
+      if (!trimesh_from_strips(tri, &geometry->vertices[0].x, &geometry->coords[0].x, geometry->indices, geometry->num_vertices) ||
+          !trimesh_optimize(tri)) {
+         trimesh_release(tri);
+         goto out;
+      }
+      ++run->num_tris;
+   }
+   stage_add(&stages[STAGE_TRIMESH], start);
+
+   char path[1024];
+   start = now();
+   for (uint32_t i = 0; i < data->num_images; ++i) {
+      const struct ccs_image *image = &data->images[i];
+      snprintf(path, sizeof(path), "%s/%s.png", run->dir, data->objects[image->id]);
+      if (!write_image(image, 0, path, run->options))
+         goto out;
+   }
+   stage_add(&stages[STAGE_PNG], start);
+
+   char stem[1024];
+   start = now();
+   for (uint32_t i = 0; i < data->num_meshes; ++i) {
+      const struct ccs_mesh *mesh = &data->meshes[i];
+      snprintf(path, sizeof(path), "%s.png", data->objects[mesh->mid + 1]);
+      snprintf(stem, sizeof(stem), "%s/%s", run->dir, data->objects[mesh->id]);
+      if (!write_mesh(&run->tris[i], path, data->objects[mesh->id], stem, NULL))
+         goto out;
+   }
+   stage_add(&stages[STAGE_OBJ], start);
+   stage_add(&stages[STAGE_TOTAL], total);
+
+   if (first) {
+      // sizes only known after the first pass
+      stages[STAGE_INPUT].bytes = stages[STAGE_PARSE].bytes = stages[STAGE_DECODE].bytes = stages[STAGE_TOTAL].bytes = input.size;
+      stages[STAGE_INPUT].items = stages[STAGE_PARSE].items = data->num_chunks;
+      stages[STAGE_DECODE].items = stages[STAGE_TOTAL].items = data->num_meshes + data->num_images;
+      stages[STAGE_TRIMESH].items = stages[STAGE_OBJ].items = data->num_meshes;
+      stages[STAGE_PNG].items = data->num_images;
+
+      for (uint32_t i = 0; i < data->num_meshes; ++i) {
+         const struct ccs_mesh *mesh = &data->meshes[i];
+         stages[STAGE_TRIMESH].bytes += (uint64_t)mesh->num_vertices * (sizeof(struct ccs_vec3f) + sizeof(struct ccs_vec2f) + sizeof(uint32_t));
+         snprintf(path, sizeof(path), "%s/%s.obj", run->dir, data->objects[mesh->id]);
+         stages[STAGE_OBJ].bytes += file_size(path);
+         snprintf(path, sizeof(path), "%s/%s.mtl", run->dir, data->objects[mesh->id]);
+         stages[STAGE_OBJ].bytes += file_size(path);
+      }
+
+      // pixels the encoder consumes, expanded RGBA or the indices as stored
+      for (uint32_t i = 0; i < data->num_images; ++i) {
+         const struct ccs_image *image = &data->images[i];
+         stages[STAGE_PNG].bytes += (uint64_t)image->width * image->height * (run->options->png_palette ? image->bpp : 32) / 8;
+      }
+   }
+
+   ret = true;
+
+out:
+   release_trimeshes(run);
+   ccs_data_reset(&run->data);
+   chck_buffer_release(&buffer);
+   ccs_input_release(&input);
+   return ret;
+}
+
+static void
+print_stages(FILE *out, const struct bench_config *config, const struct bench_stage *stages, uint64_t archive_size)
+{
+   assert(out && config && stages);
+
+   // one JSON object per line, keys and their order are stable
+   fprintf(out, "{\"bench\":\"config\",\"meshes\":%u,\"vertices\":%u,\"images\":%u,\"size\":%u,\"bpp\":%u,\"png\":\"%s\",\"input\":\"%s\",\"iterations\":%u,\"seed\":%u,\"archive_bytes\":%llu}\n",
+         config->meshes, config->vertices, config->images, 1u << config->exponent, config->bpp, (config->png_palette ? "palette" : "rgba"),
+         (config->gzip ? "gzip" : "raw"), config->iterations, config->seed, (unsigned long long)archive_size);
+
+   for (uint32_t i = 0; i < STAGE_LAST; ++i) {
+      const struct bench_stage *stage = &stages[i];
+      const double min = (stage->min > 0 ? stage->min : 1e-9);
+      fprintf(out, "{\"bench\":\"%s\",\"runs\":%u,\"min_s\":%.6f,\"mean_s\":%.6f,\"bytes\":%llu,\"items\":%llu,\"mb_s\":%.3f,\"items_s\":%.3f}\n",
+            stage->name, stage->runs, stage->min, (stage->runs ? stage->sum / stage->runs : 0.0),
+            (unsigned long long)stage->bytes, (unsigned long long)stage->items,
+            stage->bytes / min / 1e6, stage->items / min);
+   }
+}
+
+static bool
+parse_u32(const char *arg, uint32_t min, uint32_t max, uint32_t *out)
+{
+   assert(arg && out);
+
+   char *end;
+   const unsigned long v = strtoul(arg, &end, 10);
+   if (!*arg || *end || v < min || v > max)
+      return false;
+
+   *out = v;
+   return true;
+}
+
+static void
+usage(const char *name)
+{
+   assert(name);
+
+   const char *base;
+   if ((base = strrchr(name, '/'))) base++; else base = name;
+   fprintf(stderr, "usage: %s [options]\n\n", base);
+   fprintf(stderr, "  -m, --meshes N       meshes in the synthetic archive (default: 64)\n");
+   fprintf(stderr, "  -V, --vertices N     vertices per mesh (default: 4096)\n");
+   fprintf(stderr, "  -i, --images N       images in the synthetic archive (default: 64)\n");
+   fprintf(stderr, "  -s, --size EXP       images are 2^EXP pixels square, 0-10 (default: 8)\n");
+   fprintf(stderr, "  -b, --bpp N          image depth: 4, 8 or 0 to alternate (default: 0)\n");
+   fprintf(stderr, "  -r, --raw            uncompressed input instead of gzip\n");
+   fprintf(stderr, "      --png-palette    write indexed PNGs instead of RGBA\n");
+   fprintf(stderr, "  -n, --iterations N   runs per stage (default: 5)\n");
+   fprintf(stderr, "      --seed N         generator seed (default: 1)\n");
+   fprintf(stderr, "  -o, --output DIR     scratch directory (default: temporary directory)\n");
+   fprintf(stderr, "  -h, --help           show this help\n");
+}
+
+int
+main(int argc, char **argv)
+{
+   struct bench_config config = {
+      .meshes = 64,
+      .vertices = 4096,
+      .images = 64,
+      .exponent = 8,
+      .bpp = 0,
+      .gzip = true,
+      .iterations = 5,
+      .seed = 1,
+   };
+
+   const char *output = NULL;
+
+   enum {
+      OPT_SEED = 0x100,
+      OPT_PNG_PALETTE,
+   };
+
+   static const struct option opts[] = {
+      { "meshes", required_argument, NULL, 'm' },
+      { "vertices", required_argument, NULL, 'V' },
+      { "images", required_argument, NULL, 'i' },
+      { "size", required_argument, NULL, 's' },
+      { "bpp", required_argument, NULL, 'b' },
+      { "raw", no_argument, NULL, 'r' },
+      { "png-palette", no_argument, NULL, OPT_PNG_PALETTE },
+      { "iterations", required_argument, NULL, 'n' },
+      { "seed", required_argument, NULL, OPT_SEED },
+      { "output", required_argument, NULL, 'o' },
+      { "help", no_argument, NULL, 'h' },
+      { NULL, 0, NULL, 0 },
+   };
+
+   int c;
+   bool ok = true;
+   while ((c = getopt_long(argc, argv, "m:V:i:s:b:rn:o:h", opts, NULL)) != -1) {
+      switch (c) {
+         // reader limits: 10000 objects, 100000 vertices per mesh, 2^10 pixels square images
+         case 'm': ok = parse_u32(optarg, 0, 2500, &config.meshes); break;
+         case 'V': ok = parse_u32(optarg, 3, 100000, &config.vertices); break;
+         case 'i': ok = parse_u32(optarg, 0, 2500, &config.images); break;
+         case 's': ok = parse_u32(optarg, 0, 10, &config.exponent); break;
+         case 'b': ok = parse_u32(optarg, 0, 8, &config.bpp) && (config.bpp == 0 || config.bpp == 4 || config.bpp == 8); break;
+         case 'r': config.gzip = false; break;
+         case OPT_PNG_PALETTE: config.png_palette = true; break;
+         case 'n': ok = parse_u32(optarg, 1, 100000, &config.iterations); break;
+         case OPT_SEED: ok = parse_u32(optarg, 0, UINT32_MAX, &config.seed); break;
+         case 'o': output = optarg; break;
+         case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+         default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+      }
+
+      if (!ok) {
+         fprintf(stderr, "invalid value: %s\n", optarg);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (optind != argc) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   char dir[1024];
+   if (output) {
+      snprintf(dir, sizeof(dir), "%s", output);
+      if (mkdir(dir, 0755) != 0 && access(dir, W_OK) != 0) {
+         fprintf(stderr, "cannot create directory: %s\n", dir);
+         return EXIT_FAILURE;
+      }
+   } else {
+      const char *tmp = getenv("TMPDIR");
+      snprintf(dir, sizeof(dir), "%s/guhck_bench.XXXXXX", (tmp && *tmp ? tmp : "/tmp"));
+      if (!mkdtemp(dir)) {
+         fprintf(stderr, "cannot create temporary directory: %s\n", dir);
+         return EXIT_FAILURE;
+      }
+   }
+
+   struct bench_buf buf;
+   memset(&buf, 0, sizeof(buf));
+   char archive[1100];
+   snprintf(archive, sizeof(archive), "%s/bench.ccs%s", dir, (config.gzip ? ".gz" : ""));
+   if (!generate(&buf, &config) || !write_file(archive, &buf, config.gzip)) {
+      fprintf(stderr, "cannot generate archive: %s\n", archive);
+      free(buf.data);
+      return EXIT_FAILURE;
+   }
+   free(buf.data);
+
+   struct bench_stage stages[STAGE_LAST] = {
+      [STAGE_INPUT] = { .name = (config.gzip ? "inflate" : "map") },
+      [STAGE_PARSE] = { .name = "parse" },
+      [STAGE_DECODE] = { .name = "decode" },
+      [STAGE_TRIMESH] = { .name = "trimesh" },
+      [STAGE_PNG] = { .name = "png" },
+      [STAGE_OBJ] = { .name = "obj" },
+      [STAGE_TOTAL] = { .name = "total" },
+   };
+
+   const struct export_options options = {
+      .png_level = -1,
+      .png_filters = -1,
+      .png_palette = config.png_palette,
+      .filter = { .kinds = CCS_FILTER_ALL },
+   };
+
+   struct bench_run run = {
+      .options = &options,
+      .dir = dir,
+      .archive = archive,
+      .stages = stages,
+   };
+
+   int ret = EXIT_SUCCESS;
+   if (config.meshes && (!(run.tris = calloc(config.meshes, sizeof(struct trimesh))) ||
+                         !(run.geometries = calloc(config.meshes, sizeof(struct ccs_geometry))))) {
+      fprintf(stderr, "not enough memory\n");
+      ret = EXIT_FAILURE;
+   }
+
+   for (uint32_t i = 0; ret == EXIT_SUCCESS && i < config.iterations; ++i) {
+      if (!run_iteration(&run, i == 0)) {
+         fprintf(stderr, "benchmark failed on iteration %u\n", i);
+         ret = EXIT_FAILURE;
+      }
+   }
+
+   if (ret == EXIT_SUCCESS)
+      print_stages(stdout, &config, stages, file_size(archive));
+
+   free(run.tris);
+   free(run.geometries);
+   ccs_data_release(&run.data);
+
+   if (!output)
+      remove_dir(dir);
+
+   return ret;
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
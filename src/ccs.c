@@ -0,0 +1,788 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <chck/buffer/buffer.h>
+#include "ccs.h"
+#include "kernels.h"
+#include "arena.h"
+#include "view.h"
+
+uint32_t ccs_verbose = 0;
+
+static void
+ccs_debug(const char *fmt, ...)
+{
+   assert(fmt);
+
+   if (!ccs_verbose)
+      return;
+
+   va_list args;
+   va_start(args, fmt);
+   vfprintf(stderr, fmt, args);
+   va_end(args);
+}
+
+static bool
+inflate_gzip(const uint8_t *src, size_t size, void **out_data, size_t *out_size)
+{
+   assert(src && out_data && out_size);
+
+   // ISIZE trailer holds the uncompressed size modulo 2^32.
+   // Deflate can't do better than ~1032:1, so clamp bogus trailers.
+   size_t mem = (uint32_t)src[size - 4] | (uint32_t)src[size - 3] << 8 | (uint32_t)src[size - 2] << 16 | (uint32_t)src[size - 1] << 24;
+   if (mem > size * 1032) mem = size * 1032;
+   if (mem < size) mem = size;
+
+   uint8_t *data;
+   if (!(data = malloc(mem)))
+      return false;
+
+   z_stream z;
+   memset(&z, 0, sizeof(z));
+   if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK)
+      goto fail;
+
+   size_t in = 0, out = 0;
+   while (1) {
+      if (out == mem) {
+         uint8_t *tmp;
+         if (!(tmp = realloc(data, mem * 2)))
+            goto fail_inflate;
+         data = tmp;
+         mem *= 2;
+      }
+
+      z.next_in = (Bytef*)src + in;
+      z.avail_in = (size - in > UINT_MAX ? UINT_MAX : size - in);
+      z.next_out = data + out;
+      z.avail_out = (mem - out > UINT_MAX ? UINT_MAX : mem - out);
+      const uInt avail_in = z.avail_in, avail_out = z.avail_out;
+
+      const int ret = inflate(&z, Z_NO_FLUSH);
+      in += avail_in - z.avail_in;
+      out += avail_out - z.avail_out;
+
+      if (ret == Z_STREAM_END) {
+         // concatenated gzip members, same as gzread
+         if (size - in < 2 || src[in] != 0x1f || src[in + 1] != 0x8b)
+            break;
+         inflateReset(&z);
+      } else if (ret == Z_BUF_ERROR && in == size) {
+         // truncated stream, keep what we got like gzread does
+         break;
+      } else if (ret != Z_OK && !(ret == Z_BUF_ERROR && out == mem)) {
+         goto fail_inflate;
+      }
+   }
+
+   inflateEnd(&z);
+
+   if (out < mem) {
+      uint8_t *tmp;
+      if (out && (tmp = realloc(data, out)))
+         data = tmp;
+   }
+
+   *out_data = data;
+   *out_size = out;
+   return true;
+
+fail_inflate:
+   inflateEnd(&z);
+fail:
+   free(data);
+   return false;
+}
+
+static bool
+read_fd(int fd, void **out_data, size_t *out_size)
+{
+   assert(out_data && out_size);
+
+   size_t mem = 4096000, size = 0;
+   uint8_t *data;
+   if (!(data = malloc(mem)))
+      return false;
+
+   ssize_t ret;
+   while ((ret = read(fd, data + size, mem - size)) > 0) {
+      if ((size += ret) < mem)
+         continue;
+
+      uint8_t *tmp;
+      if (!(tmp = realloc(data, mem * 2))) {
+         free(data);
+         return false;
+      }
+
+      data = tmp;
+      mem *= 2;
+   }
+
+   if (ret < 0) {
+      free(data);
+      return false;
+   }
+
+   *out_data = data;
+   *out_size = size;
+   return true;
+}
+
+void
+ccs_input_release(struct ccs_input *input)
+{
+   assert(input);
+
+   if (input->mapped)
+      munmap(input->data, input->mapped);
+   else if (!input->borrowed)
+      free(input->data);
+
+   memset(input, 0, sizeof(struct ccs_input));
+}
+
+bool
+ccs_input_open(struct ccs_input *input, const char *path)
+{
+   assert(input && path);
+   memset(input, 0, sizeof(struct ccs_input));
+
+   int fd;
+   if ((fd = open(path, O_RDONLY)) < 0)
+      return false;
+
+   // map regular files in place, slurp anything else (pipes, devices)
+   struct stat st;
+   if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *map;
+      if ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+         posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+         input->data = map;
+         input->size = input->mapped = st.st_size;
+      }
+   }
+
+   if (!input->data && !read_fd(fd, &input->data, &input->size)) {
+      close(fd);
+      return false;
+   }
+
+   close(fd);
+
+   const uint8_t *src = input->data;
+   if (input->size > 18 && src[0] == 0x1f && src[1] == 0x8b) {
+      void *data;
+      size_t size;
+      if (!inflate_gzip(src, input->size, &data, &size)) {
+         ccs_input_release(input);
+         return false;
+      }
+
+      ccs_input_release(input);
+      input->data = data;
+      input->size = size;
+   }
+
+   return true;
+}
+
+bool
+ccs_input_from_memory(struct ccs_input *input, const void *data, size_t size)
+{
+   assert(input && (data || !size));
+   memset(input, 0, sizeof(struct ccs_input));
+
+   const uint8_t *src = data;
+   if (size > 18 && src[0] == 0x1f && src[1] == 0x8b)
+      return inflate_gzip(src, size, &input->data, &input->size);
+
+   input->data = (void*)data;
+   input->size = size;
+   input->borrowed = true;
+   return true;
+}
+
+enum read_result {
+   READ_OK,
+   READ_INVALID, // corrupted chunk, skipped
+   READ_FAILED, // out of memory
+};
+
+static enum read_result
+read_image(struct view *view, uint32_t num_objects, struct ccs_image *image, struct arena *arena)
+{
+   assert(view && image && arena);
+
+   // id, palette id, ?, ?, type, ?, ?, width and height exponents, 10 bytes ?
+   if (!view_has(view, 28))
+      return READ_INVALID;
+
+   // our IDs start from zero
+   image->id = view_u32(view) - 1;
+   image->pid = view_u32(view) - 1;
+
+   {
+      const uint32_t u1 = view_u32(view);
+      const uint8_t u2 = view_u8(view);
+      const uint8_t type = view_u8(view);
+      const uint8_t u4 = view_u8(view);
+      const uint8_t u5 = view_u8(view);
+      ccs_debug("1: %u\n2: %u\n3: %u\n4: %u\n5: %u\n", u1, u2, type, u4, u5);
+
+      // 1024 is the largest texture the PS2 GS addresses
+      const uint8_t width = view_u8(view), height = view_u8(view);
+      view_skip(view, 10); // ???
+
+      if (image->id >= num_objects || width > 10 || height > 10) {
+         ccs_debug("-!- image: id %u of %u objects, size 2^%u x 2^%u\n", image->id, num_objects, width, height);
+         return READ_INVALID;
+      }
+
+      image->width = 1u << width;
+      image->height = 1u << height;
+
+      // indices are used in place, 4bpp ones stay packed
+      const size_t size = (size_t)image->width * image->height;
+      const uint8_t *indices = NULL;
+      if (type == 19) {
+         // 32bit palette
+         image->bpp = 8;
+         if (view_has(view, size))
+            indices = view_ptr(view);
+      } else if (type == 20) {
+         // 16bit palette, two pixels per byte, low nibble first
+         image->bpp = 4;
+         if (view_has(view, (size + 1) / 2))
+            indices = view_ptr(view);
+      } else {
+         ccs_debug("-!- unknown palette\n");
+         image->bpp = 8;
+      }
+
+      if (!indices) {
+         // unknown or truncated, export as blank
+         uint8_t *blank;
+         if (!(blank = arena_calloc(arena, 1, size)))
+            return READ_FAILED;
+         indices = blank;
+      }
+
+      image->indices = indices;
+   }
+
+   return READ_OK;
+}
+
+static enum read_result
+read_palette(struct view *view, uint32_t num_objects, struct ccs_palette *palette, struct arena *arena)
+{
+   assert(view && palette && arena);
+
+   // id, 16 bytes ?, RGBA quads with alpha in 0..128
+   if (!view_has(view, 20 + sizeof(struct ccs_color)))
+      return READ_INVALID;
+
+   // our IDs start from zero, the id only names the palette
+   palette->id = view_u32(view) - 1;
+   if (palette->id >= num_objects)
+      palette->id = CCS_NO_ID;
+
+   view_skip(view, 16); // ???
+
+   struct ccs_color *colors;
+   const size_t num_colors = view_left(view) / sizeof(struct ccs_color);
+   if (!(colors = arena_alloc(arena, num_colors * sizeof(struct ccs_color))))
+      return READ_FAILED;
+
+   memcpy(colors, view_ptr(view), num_colors * sizeof(struct ccs_color));
+   kernel_expand_alpha((uint8_t*)colors, num_colors);
+   view_skip(view, num_colors * sizeof(struct ccs_color));
+
+   palette->num_colors = num_colors;
+   palette->colors = colors;
+   return READ_OK;
+}
+
+static enum read_result
+read_mesh(struct view *view, uint32_t num_objects, struct ccs_mesh *mesh)
+{
+   assert(view && mesh);
+
+   // id, 12 bytes ?, index count, ?, 4 bytes ?, some id, material id, vertex count
+   if (!view_has(view, 40))
+      return READ_INVALID;
+
+   // our IDs start from zero
+   mesh->id = view_u32(view) - 1;
+   view_skip(view, 12); // ???
+   view_u32(view); // num_indices
+   const uint32_t unknown = view_u32(view);
+   view_skip(view, 4); // ???
+   view_u32(view); // some id
+   mesh->mid = view_u32(view) - 1; // material id
+   const uint32_t num_vertices = view_u32(view);
+
+   if (unknown == 0x80000000)
+      return READ_INVALID;
+
+   if (mesh->id >= num_objects || mesh->mid >= num_objects || !num_vertices || num_vertices > 100000) {
+      ccs_debug("-!- mesh: id %u, material %u of %u objects, %u vertices\n", mesh->id, mesh->mid, num_objects, num_vertices);
+      return READ_INVALID;
+   }
+
+   // positions, padding, strip records, normals / vcolors ?, coords
+   const size_t pad = (num_vertices * 6) % 4;
+   const size_t need = (size_t)num_vertices * (6 + 4 + 4 + 4) + pad;
+   if (!view_has(view, need))
+      return READ_INVALID;
+
+   // decoded by whoever exports the mesh, untouched otherwise
+   const uint8_t *src = view_ptr(view);
+   mesh->num_vertices = num_vertices;
+   mesh->positions = src;
+   mesh->strips = src + num_vertices * 6 + pad;
+   mesh->coords = mesh->strips + num_vertices * 4 * 2; // normals / vcolors ? in between
+   view_skip(view, need);
+   return READ_OK;
+}
+
+bool
+ccs_mesh_decode(const struct ccs_mesh *mesh, struct ccs_geometry *geometry)
+{
+   assert(mesh && geometry);
+   memset(geometry, 0, sizeof(struct ccs_geometry));
+
+   // one block for all three, freed as soon as the mesh is exported
+   const size_t num_vertices = mesh->num_vertices;
+   uint8_t *block;
+   if (!(block = malloc(num_vertices * (sizeof(struct ccs_vec3f) + sizeof(struct ccs_vec2f) + sizeof(uint32_t)))))
+      return false;
+
+   // ccs_vec3f and ccs_vec2f are plain float arrays as far as the kernels care
+   geometry->vertices = (struct ccs_vec3f*)block;
+   geometry->coords = (struct ccs_vec2f*)(block + num_vertices * sizeof(struct ccs_vec3f));
+   geometry->indices = (uint32_t*)(block + num_vertices * (sizeof(struct ccs_vec3f) + sizeof(struct ccs_vec2f)));
+   geometry->num_vertices = num_vertices;
+   kernel_fixed88_to_float(&geometry->vertices[0].x, mesh->positions, num_vertices * 3);
+   geometry->num_triangles = kernel_strip_flags(geometry->indices, mesh->strips, num_vertices);
+   kernel_fixed88_to_float(&geometry->coords[0].x, mesh->coords, num_vertices * 2);
+   return true;
+}
+
+void
+ccs_geometry_release(struct ccs_geometry *geometry)
+{
+   assert(geometry);
+   free(geometry->vertices);
+   memset(geometry, 0, sizeof(struct ccs_geometry));
+}
+
+bool
+ccs_read_header(struct chck_buffer *buffer)
+{
+   assert(buffer);
+   uint32_t header = 0;
+   chck_buffer_read_int(&header, sizeof(header), buffer);
+   return (header == 0xcccc0001);
+}
+
+static bool
+array_reserve(void **array, uint32_t *mem, uint32_t count, size_t member)
+{
+   assert(array && mem);
+
+   if (count < *mem)
+      return true;
+
+   const uint32_t next = (*mem ? *mem * 2 : 8);
+   void *tmp;
+   if (!(tmp = realloc(*array, next * member)))
+      return false;
+
+   *array = tmp;
+   *mem = next;
+   return true;
+}
+
+static bool
+read_names(struct view *view, const char ***out_names, uint32_t num_names, struct arena *arena)
+{
+   assert(view && out_names && arena);
+
+   if (!num_names)
+      return true;
+
+   if (view_left(view) / 32 < num_names)
+      return false;
+
+   // intern all names into one string block
+   const char *raw = (const char*)view_ptr(view);
+   size_t total = 0;
+   for (uint32_t i = 0; i < num_names; ++i)
+      total += strnlen(raw + i * 32, 32) + 1;
+
+   const char **names;
+   char *block;
+   if (!(names = arena_alloc(arena, num_names * sizeof(char*))) || !(block = arena_alloc(arena, total)))
+      return false;
+
+   for (uint32_t i = 0; i < num_names; ++i) {
+      const size_t len = strnlen(raw + i * 32, 32);
+      memcpy(block, raw + i * 32, len);
+      block[len] = 0;
+      names[i] = block;
+      block += len + 1;
+   }
+
+   view_skip(view, (size_t)num_names * 32);
+   *out_names = names;
+   return true;
+}
+
+const char*
+ccs_chunk_type_name(uint32_t type)
+{
+   switch (type) {
+      case 0xcccc2400: return "bin";
+      case 0xcccc0100: return "object";
+      case 0xcccc0a00: return "object_a00";
+      case 0xcccc2000: return "object_2000";
+      case 0xcccc0200: return "material";
+      case 0xcccc0700: return "animation";
+      case 0xcccc0800: return "mesh";
+      case 0xcccc0900: return "cmp";
+      case 0xcccc0400: return "palette";
+      case 0xcccc0300: return "image";
+      default: break;
+   }
+   return "unknown";
+}
+
+static bool
+read_chunk_index(struct view *view, struct ccs_data *data)
+{
+   assert(view && data);
+
+   struct ccs_chunk *chunks = NULL;
+   uint32_t num_chunks = 0, mem_chunks = 0;
+
+   // walk the chunk headers only, payloads are decoded later on demand
+   while (view_has(view, 4)) {
+      const uint32_t filetype = view_u32(view);
+      if (filetype == 0x0 || filetype == 0xcccc0005 || filetype == 0xcccc1b00)
+         break;
+
+      if (!view_has(view, 4))
+         break;
+
+      // every chunk is validated here once, payload readers only check their own fields
+      const uint32_t chunk_size = view_u32(view);
+      const size_t start_offset = view->pos;
+      if (!view_has(view, (uint64_t)chunk_size * 4))
+         break;
+
+      if (!array_reserve((void**)&chunks, &mem_chunks, num_chunks, sizeof(struct ccs_chunk))) {
+         free(chunks);
+         return false;
+      }
+
+      // every chunk seems to start with the ID of its object
+      const uint32_t id = (chunk_size > 0 ? view_u32(view) : 0);
+
+      struct ccs_chunk *chunk = &chunks[num_chunks++];
+      chunk->type = filetype;
+      chunk->offset = start_offset;
+      chunk->size = (size_t)chunk_size * 4;
+      chunk->id = (id > 0 && id - 1 < data->num_objects ? id - 1 : CCS_NO_ID);
+
+      // image chunks overlap the next one
+      const size_t trail = (filetype == 0xcccc0300 ? 200 : 0);
+      view_seek(view, start_offset + chunk->size - (chunk->size >= trail ? trail : 0));
+   }
+
+   if (num_chunks && !(data->chunks = arena_alloc(&data->arena, num_chunks * sizeof(struct ccs_chunk)))) {
+      free(chunks);
+      return false;
+   }
+
+   if (num_chunks)
+      memcpy((struct ccs_chunk*)data->chunks, chunks, num_chunks * sizeof(struct ccs_chunk));
+
+   data->num_chunks = num_chunks;
+   free(chunks);
+   return true;
+}
+
+static bool
+filter_match_object(const struct ccs_filter *filter, const struct ccs_data *data, uint32_t id)
+{
+   assert(filter && data);
+
+   if (!filter->num_objects)
+      return true;
+
+   if (id >= data->num_objects)
+      return false;
+
+   for (uint32_t i = 0; i < filter->num_objects; ++i) {
+      if (!strcmp(filter->objects[i], data->objects[id]))
+         return true;
+   }
+
+   return false;
+}
+
+bool
+ccs_read_chunks(struct chck_buffer *buffer, struct ccs_data *data, const struct ccs_filter *filter)
+{
+   assert(buffer && data && filter);
+
+   bool ret = false;
+   struct ccs_palette *palettes = NULL;
+   struct ccs_image *images = NULL;
+   struct ccs_mesh *meshes = NULL;
+   uint32_t *first_palette = NULL;
+   bool *wanted = NULL;
+   uint32_t num_palettes = 0, mem_palettes = 0;
+   uint32_t num_images = 0, mem_images = 0, mem_first = 0;
+   uint32_t num_meshes = 0, mem_meshes = 0;
+
+   if (data->num_chunks && !(wanted = calloc(data->num_chunks, sizeof(bool))))
+      return false;
+
+   // decide what to decode, palettes go along with the image that follows them
+   {
+      bool image_wanted = false;
+      for (uint32_t i = data->num_chunks; i > 0; --i) {
+         const struct ccs_chunk *chunk = &data->chunks[i - 1];
+         switch (chunk->type) {
+            case 0xcccc0800: // MESH
+               wanted[i - 1] = ((filter->kinds & CCS_FILTER_MESH) && filter_match_object(filter, data, chunk->id) && !(filter->skip && filter->skip[i - 1]));
+               break;
+            case 0xcccc0300: // IMAGE
+               wanted[i - 1] = image_wanted = ((filter->kinds & CCS_FILTER_IMAGE) && filter_match_object(filter, data, chunk->id) && !(filter->skip && filter->skip[i - 1]));
+               break;
+            case 0xcccc0400: // PALETTE
+               wanted[i - 1] = image_wanted;
+               break;
+            default:break;
+         }
+      }
+   }
+
+   uint32_t image_palettes = 0; // palettes since the last image
+
+   for (uint32_t c = 0; c < data->num_chunks; ++c) {
+      const struct ccs_chunk *chunk = &data->chunks[c];
+
+      if (!wanted[c]) {
+         // a skipped image still owns the palettes before it
+         if (chunk->type == 0xcccc0300)
+            image_palettes = num_palettes;
+         continue;
+      }
+
+      // the index only holds chunks that fit the archive
+      struct view view;
+      if (!view_init(&view, buffer->buffer, buffer->size, chunk->offset, chunk->size))
+         continue;
+
+      enum read_result result = READ_OK;
+      switch (chunk->type) {
+         case 0xcccc2400: // BIN
+            // STRING
+            break;
+         case 0xcccc0100: // OBJECT
+         case 0Xcccc0a00:
+         case 0Xcccc2000:
+            break;
+         case 0xcccc0200: // MATERIAL
+            break;
+         case 0xcccc0700: // ANIMATION
+            break;
+         case 0xcccc0800: // MESH
+            if (!array_reserve((void**)&meshes, &mem_meshes, num_meshes, sizeof(struct ccs_mesh)))
+               goto out;
+            memset(&meshes[num_meshes], 0, sizeof(struct ccs_mesh));
+            meshes[num_meshes].chunk = c;
+            if ((result = read_mesh(&view, data->num_objects, &meshes[num_meshes])) == READ_OK)
+               ++num_meshes;
+            break;
+         case 0xcccc0900: // CMP
+            break;
+         case 0xcccc0400: // PALETTE
+            if (!array_reserve((void**)&palettes, &mem_palettes, num_palettes, sizeof(struct ccs_palette)))
+               goto out;
+            memset(&palettes[num_palettes], 0, sizeof(struct ccs_palette));
+            if ((result = read_palette(&view, data->num_objects, &palettes[num_palettes], &data->arena)) == READ_OK)
+               ++num_palettes;
+            break;
+         case 0xcccc0300: // IMAGE
+            {
+               if (!array_reserve((void**)&images, &mem_images, num_images, sizeof(struct ccs_image)) ||
+                   !array_reserve((void**)&first_palette, &mem_first, num_images, sizeof(uint32_t)))
+                  goto out;
+
+               memset(&images[num_images], 0, sizeof(struct ccs_image));
+               images[num_images].chunk = c;
+               if ((result = read_image(&view, data->num_objects, &images[num_images], &data->arena)) != READ_OK) {
+                  // a rejected image still owns the palettes before it
+                  image_palettes = num_palettes;
+                  break;
+               }
+
+               // image owns the palettes that preceded it
+               first_palette[num_images] = image_palettes;
+               images[num_images].num_palettes = num_palettes - image_palettes;
+               image_palettes = num_palettes;
+               ++num_images;
+            }
+            break;
+         default:break;
+      }
+
+      if (result == READ_FAILED)
+         goto out;
+   }
+
+   // move the final arrays into the arena
+   struct ccs_palette *arena_palettes = NULL;
+   if (num_palettes && !(arena_palettes = arena_alloc(&data->arena, num_palettes * sizeof(struct ccs_palette))))
+      goto out;
+
+   struct ccs_image *arena_images = NULL;
+   if (num_images && !(arena_images = arena_alloc(&data->arena, num_images * sizeof(struct ccs_image))))
+      goto out;
+
+   struct ccs_mesh *arena_meshes = NULL;
+   if (num_meshes && !(arena_meshes = arena_alloc(&data->arena, num_meshes * sizeof(struct ccs_mesh))))
+      goto out;
+
+   if (num_palettes)
+      memcpy(arena_palettes, palettes, num_palettes * sizeof(struct ccs_palette));
+   if (num_meshes)
+      memcpy(arena_meshes, meshes, num_meshes * sizeof(struct ccs_mesh));
+
+   for (uint32_t i = 0; i < num_images; ++i) {
+      arena_images[i] = images[i];
+      arena_images[i].palettes = (images[i].num_palettes ? arena_palettes + first_palette[i] : NULL);
+   }
+
+   data->num_images = num_images;
+   data->images = (const struct ccs_image*)arena_images;
+   data->num_meshes = num_meshes;
+   data->meshes = (const struct ccs_mesh*)arena_meshes;
+   ret = true;
+
+out:
+   free(wanted);
+   free(palettes);
+   free(images);
+   free(first_palette);
+   free(meshes);
+   return ret;
+}
+
+void
+ccs_data_reset(struct ccs_data *data)
+{
+   assert(data);
+   struct arena arena = data->arena;
+   arena_reset(&arena);
+   memset(data, 0, sizeof(struct ccs_data));
+   data->arena = arena;
+}
+
+void
+ccs_data_release(struct ccs_data *data)
+{
+   assert(data);
+   arena_release(&data->arena);
+   memset(data, 0, sizeof(struct ccs_data));
+}
+
+bool
+ccs_read_index(struct chck_buffer *buffer, struct ccs_data *data)
+{
+   assert(buffer && data);
+
+   struct view view;
+   if (!view_init(&view, buffer->buffer, buffer->size, 0, buffer->size))
+      return false;
+
+   view_seek(&view, buffer->curpos - buffer->buffer);
+
+   {
+      uint32_t len;
+      char *name;
+      if (!view_has(&view, 4) || !view_has(&view, (len = view_u32(&view))) ||
+          !(name = arena_strndup(&data->arena, (const char*)view_ptr(&view), len)))
+         return false;
+
+      view_skip(&view, len);
+      data->name = name;
+   }
+
+   // 23 bytes of useless waste, 24 bytes ???, file and object counts
+   if (!view_has(&view, 23 + 24 + 8))
+      return false;
+
+   view_skip(&view, 23 + 24);
+   data->num_files = view_u32(&view);
+   data->num_objects = view_u32(&view);
+
+   // format counts from 1..9, we count from 0..9
+   data->num_files -= (data->num_files > 0);
+   data->num_objects -= (data->num_objects > 0);
+
+   if (data->num_files > 10000 || data->num_objects > 10000) {
+      ccs_debug("too many files: %u, %u\n", data->num_files, data->num_objects);
+      return false;
+   }
+
+   // read file names
+   if (!view_has(&view, 32))
+      return false;
+   view_skip(&view, 32); // ???
+   if (!read_names(&view, &data->files, data->num_files, &data->arena))
+      return false;
+
+   // read object names
+   if (!view_has(&view, 32))
+      return false;
+   view_skip(&view, 32); // ???
+   if (!read_names(&view, &data->objects, data->num_objects, &data->arena))
+      return false;
+
+   // 8 bytes ???, an archive without them has no chunks
+   view_skip(&view, (view_has(&view, 8) ? 8 : view_left(&view)));
+
+   if (!read_chunk_index(&view, data))
+      return false;
+
+   // trailing 12 bytes ???
+   chck_buffer_seek(buffer, view.pos, SEEK_SET);
+   return true;
+}
+
+bool
+ccs_read_contents(struct chck_buffer *buffer, struct ccs_data *data, const struct ccs_filter *filter)
+{
+   assert(buffer && data && filter);
+   return ccs_read_index(buffer, data) && ccs_read_chunks(buffer, data, filter);
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
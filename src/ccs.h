@@ -0,0 +1,154 @@
+#ifndef __guhck_ccs__
+#define __guhck_ccs__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "arena.h"
+
+struct chck_buffer;
+
+struct ccs_input {
+   void *data;
+   size_t size;
+   size_t mapped; // length of mmap, 0 when data is heap allocated
+   bool borrowed; // data belongs to the caller
+};
+
+struct ccs_color {
+   uint8_t r, g, b, a;
+};
+
+struct ccs_palette {
+   uint32_t id;
+   uint32_t num_colors;
+   const struct ccs_color *colors;
+};
+
+struct ccs_image {
+   uint32_t id;
+   uint32_t pid;
+   // 6 bytes ???
+   uint32_t width, height;
+   // 10 bytes ???
+   uint32_t num_palettes;
+   const struct ccs_palette *palettes;
+   uint32_t bpp; // 4bpp indices are packed, low nibble first
+   const uint8_t *indices; // may point into the archive buffer
+   uint32_t chunk; // index in ccs_data chunks
+};
+
+struct ccs_vec3f {
+   float x, y, z;
+};
+
+struct ccs_vec2f {
+   float x, y;
+};
+
+/** Mesh header, the payload stays in the archive until ccs_mesh_decode. */
+struct ccs_mesh {
+   uint32_t id;
+   uint32_t mid;
+   uint32_t num_vertices;
+   const uint8_t *positions; // 8.8 fixed point xyz per vertex
+   const uint8_t *strips; // 4 byte record per vertex, strip flag in the last byte
+   const uint8_t *coords; // 8.8 fixed point uv per vertex
+   uint32_t chunk; // index in ccs_data chunks
+};
+
+struct ccs_geometry {
+   uint32_t num_vertices;
+   uint32_t num_triangles;
+   uint32_t *indices; // strip flag per vertex
+   struct ccs_vec3f *vertices;
+   struct ccs_vec2f *coords;
+};
+
+#define CCS_NO_ID UINT32_MAX
+
+struct ccs_chunk {
+   uint32_t type;
+   size_t offset; // payload offset in archive, archives may be over 4 GiB
+   size_t size; // payload size in bytes
+   uint32_t id; // object, CCS_NO_ID if none
+};
+
+enum ccs_filter_kind {
+   CCS_FILTER_MESH = 1 << 0,
+   CCS_FILTER_IMAGE = 1 << 1,
+   CCS_FILTER_ALL = ~0,
+};
+
+struct ccs_filter {
+   uint32_t kinds; // mask of ccs_filter_kind, 0 decodes nothing
+   uint32_t num_objects;
+   const char **objects; // object names to decode, all if none
+   const bool *skip; // per indexed chunk, true leaves it undecoded, NULL skips none
+};
+
+struct ccs_data {
+   const char *name;
+   // 24 bytes ???
+   uint32_t num_files;
+   uint32_t num_objects;
+   // 32 bytes ???
+   const char **files;
+   const char **objects;
+   // 8 bytes ???
+   // { read until fileType != 0xcccc0005
+   //    uint32_t fileType;
+   //    uint32_t chunkSize;
+   //    void *data;
+   // }
+   // 12 bytes ???
+
+   uint32_t num_chunks;
+   const struct ccs_chunk *chunks;
+
+   uint32_t num_images;
+   const struct ccs_image *images;
+   uint32_t num_meshes;
+   const struct ccs_mesh *meshes;
+
+   // owns everything above
+   struct arena arena;
+};
+
+/** Parser debug output to stderr, 0 is quiet. */
+extern uint32_t ccs_verbose;
+
+/** Map or read archive at path, gzip compressed archives are inflated. */
+bool ccs_input_open(struct ccs_input *input, const char *path);
+void ccs_input_release(struct ccs_input *input);
+
+/** Use archive in memory, raw archives are read in place and must outlive the input. */
+bool ccs_input_from_memory(struct ccs_input *input, const void *data, size_t size);
+
+bool ccs_read_header(struct chck_buffer *buffer);
+
+/** Read archive name, file and object names and the chunk index, decodes no payloads. */
+bool ccs_read_index(struct chck_buffer *buffer, struct ccs_data *data);
+
+/**
+ * Read headers of indexed chunks that pass the filter.
+ * Image indices and mesh payloads are referenced in the archive, not copied.
+ */
+bool ccs_read_chunks(struct chck_buffer *buffer, struct ccs_data *data, const struct ccs_filter *filter);
+
+/** ccs_read_index followed by ccs_read_chunks. */
+bool ccs_read_contents(struct chck_buffer *buffer, struct ccs_data *data, const struct ccs_filter *filter);
+
+/** Decode vertices, coords and strip flags of mesh, the archive must still be around. */
+bool ccs_mesh_decode(const struct ccs_mesh *mesh, struct ccs_geometry *geometry);
+void ccs_geometry_release(struct ccs_geometry *geometry);
+
+/** Free everything but keep the arena around for the next archive. */
+void ccs_data_reset(struct ccs_data *data);
+void ccs_data_release(struct ccs_data *data);
+
+const char* ccs_chunk_type_name(uint32_t type);
+
+#endif /* __guhck_ccs__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200809L
+#include "emitter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#define EMITTER_BLOCK (256 * 1024)
+
+static void
+flush(struct emitter *emitter)
+{
+   assert(emitter);
+
+   // grow the buffer, doubling keeps any reserve satisfiable
+   char *buf;
+   if (!emitter->error && (buf = realloc(emitter->buf, emitter->mem * 2))) {
+      emitter->buf = buf;
+      emitter->mem *= 2;
+   } else {
+      emitter->error = true;
+      emitter->len = 0;
+   }
+}
+
+static inline char*
+reserve(struct emitter *emitter, size_t len)
+{
+   assert(emitter && len <= emitter->mem);
+
+   if (emitter->mem - emitter->len < len)
+      flush(emitter);
+
+   return emitter->buf + emitter->len;
+}
+
+bool
+emitter_open_memory(struct emitter *emitter)
+{
+   assert(emitter);
+   memset(emitter, 0, sizeof(struct emitter));
+
+   if (!(emitter->buf = malloc(EMITTER_BLOCK)))
+      return false;
+
+   emitter->mem = EMITTER_BLOCK;
+   return true;
+}
+
+bool
+emitter_take(struct emitter *emitter, char **out_data, size_t *out_len)
+{
+   assert(emitter && out_data && out_len);
+
+   const bool ret = !emitter->error;
+   if (ret) {
+      *out_data = emitter->buf;
+      *out_len = emitter->len;
+   } else {
+      free(emitter->buf);
+   }
+
+   memset(emitter, 0, sizeof(struct emitter));
+   return ret;
+}
+
+void
+emit(struct emitter *emitter, const char *data, size_t len)
+{
+   assert(emitter && data);
+
+   while (len > 0) {
+      const size_t chunk = (len > emitter->mem ? emitter->mem : len);
+      memcpy(reserve(emitter, chunk), data, chunk);
+      emitter->len += chunk;
+      data += chunk;
+      len -= chunk;
+   }
+}
+
+void
+emit_str(struct emitter *emitter, const char *str)
+{
+   assert(str);
+   emit(emitter, str, strlen(str));
+}
+
+static inline size_t
+format_u32(char *dst, uint32_t v)
+{
+   char tmp[10];
+   size_t len = 0;
+   do {
+      tmp[len++] = '0' + v % 10;
+      v /= 10;
+   } while (v);
+
+   for (size_t i = 0; i < len; ++i)
+      dst[i] = tmp[len - 1 - i];
+   return len;
+}
+
+void
+emit_u32(struct emitter *emitter, uint32_t v)
+{
+   emitter->len += format_u32(reserve(emitter, 10), v);
+}
+
+void
+emit_float(struct emitter *emitter, float v)
+{
+   assert(emitter);
+
+   // values decoded from 8.8 fixed point are exact multiples of 1/256
+   const float scaled = v * 256.0f;
+   if (!(fabsf(scaled) < 16777216.0f) || scaled != (float)(int32_t)scaled) {
+      char tmp[64];
+      const int len = snprintf(tmp, sizeof(tmp), "%f", v);
+      if (len > 0)
+         emit(emitter, tmp, ((size_t)len < sizeof(tmp) ? (size_t)len : sizeof(tmp) - 1));
+      return;
+   }
+
+   const int32_t n = (int32_t)scaled;
+   const uint32_t m = (n < 0 ? -(uint32_t)n : (uint32_t)n);
+
+   // fraction / 256 in millionths is fraction * 15625 / 4,
+   // the remainder is a quarter so ties round half to even like printf
+   const uint32_t f = (m & 0xff) * 15625;
+   uint32_t q = f >> 2;
+   const uint32_t r = f & 3;
+   q += (r > 2 || (r == 2 && (q & 1)));
+
+   char *p = reserve(emitter, 32), *start = p;
+   if (signbit(v))
+      *p++ = '-';
+
+   p += format_u32(p, m >> 8);
+   *p++ = '.';
+   for (int i = 5; i >= 0; --i, q /= 10)
+      p[i] = '0' + q % 10;
+   p += 6;
+
+   emitter->len += p - start;
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,32 @@
+#ifndef __guhck_emitter__
+#define __guhck_emitter__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Buffered text output with fast number formatting.
+ * Collects everything in memory for the caller to hand to an output.
+ */
+struct emitter {
+   char *buf;
+   size_t len, mem;
+   bool error;
+};
+
+/** Collect the output in memory, finish with emitter_take. */
+bool emitter_open_memory(struct emitter *emitter);
+
+/** Hand the collected output to the caller to free, false if memory ran out on the way. */
+bool emitter_take(struct emitter *emitter, char **out_data, size_t *out_len);
+void emit(struct emitter *emitter, const char *data, size_t len);
+void emit_str(struct emitter *emitter, const char *str);
+void emit_u32(struct emitter *emitter, uint32_t v);
+
+/** Same output as printf("%f"), exact and fast for 8.8 fixed point values. */
+void emit_float(struct emitter *emitter, float v);
+
+#endif /* __guhck_emitter__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
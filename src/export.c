@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <png.h>
+#include "export.h"
+#include "kernels.h"
+#include "emitter.h"
+#include "mesh.h"
+
+// PNGs are encoded in memory and handed to the output as a whole
+#define PNG_SINK_BLOCK (64 * 1024)
+
+struct png_sink {
+   uint8_t *data;
+   size_t len, mem;
+};
+
+static void
+png_sink_write(png_structp png, png_bytep data, png_size_t len)
+{
+   struct png_sink *sink = png_get_io_ptr(png);
+
+   if (sink->mem - sink->len < len) {
+      size_t mem = (sink->mem ? sink->mem : PNG_SINK_BLOCK);
+      while (mem - sink->len < len)
+         mem *= 2;
+
+      uint8_t *grown;
+      if (!(grown = realloc(sink->data, mem)))
+         png_error(png, "not enough memory");
+
+      sink->data = grown;
+      sink->mem = mem;
+   }
+
+   memcpy(sink->data + sink->len, data, len);
+   sink->len += len;
+}
+
+static void
+png_sink_flush(png_structp png)
+{
+   (void)png;
+}
+
+struct png_plte {
+   png_color colors[256];
+   png_byte alpha[256];
+   int num_colors, num_alpha;
+};
+
+static bool
+write_png_rows(const uint8_t *const *rows, uint32_t width, uint32_t height, int depth, const struct png_plte *plte, const char *path, const struct export_options *options)
+{
+   assert(rows && path && options);
+
+   struct png_sink sink;
+   memset(&sink, 0, sizeof(sink));
+
+   volatile bool ret = false; // read after longjmp
+   png_structp png;
+   png_infop info = NULL;
+   if (!(png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL)))
+      goto out;
+
+   if (!(info = png_create_info_struct(png)))
+      goto out;
+
+   if (setjmp(png_jmpbuf(png)))
+      goto out;
+
+   png_set_write_fn(png, &sink, png_sink_write, png_sink_flush);
+
+   if (options->png_level >= 0)
+      png_set_compression_level(png, options->png_level);
+
+   if (options->png_filters >= 0)
+      png_set_filter(png, PNG_FILTER_TYPE_BASE, options->png_filters);
+
+   png_set_IHDR(png, info, width, height, depth, (plte ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGBA), PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+   if (plte) {
+      png_set_PLTE(png, info, plte->colors, plte->num_colors);
+      if (plte->num_alpha)
+         png_set_tRNS(png, info, plte->alpha, plte->num_alpha, NULL);
+   }
+
+   png_write_info(png, info);
+
+   // packed rows hold the leftmost pixel in the low nibble like the archive
+   if (depth < 8)
+      png_set_packswap(png);
+
+   for (uint32_t y = 0; y < height; ++y)
+      png_write_row(png, rows[y]);
+
+   png_write_end(png, info);
+   ret = true;
+
+out:
+   if (png)
+      png_destroy_write_struct(&png, (info ? &info : NULL));
+
+   if (!ret) {
+      free(sink.data);
+      return false;
+   }
+
+   return output_write(options->output, path, sink.data, sink.len);
+}
+
+bool
+write_png(const uint8_t *rgba, uint32_t width, uint32_t height, const char *path, const struct export_options *options)
+{
+   assert(rgba && path && options);
+
+   const uint8_t **rows;
+   if (!(rows = malloc((height + 1) * sizeof(uint8_t*))))
+      return false;
+
+   for (uint32_t y = 0; y < height; ++y)
+      rows[y] = rgba + (size_t)y * width * 4;
+
+   const bool ret = write_png_rows(rows, width, height, 8, NULL, path, options);
+   free(rows);
+   return ret;
+}
+
+static bool
+write_image_indexed(const struct ccs_image *image, uint32_t p, const char *path, const struct export_options *options)
+{
+   assert(image && path && options);
+
+   const struct ccs_palette *palette = &image->palettes[p];
+   const size_t count = (size_t)image->width * image->height;
+   const uint32_t num_colors = (palette->num_colors > 256 ? 256 : palette->num_colors);
+
+   // indices past the palette get transparent black entries, as the RGBA path does
+   uint32_t max_index = 0;
+   size_t bad = 0;
+   for (size_t i = 0; i < count; ++i) {
+      const uint8_t index = (image->bpp == 4 ? (i & 1 ? image->indices[i / 2] >> 4 : image->indices[i / 2] & 0x0f) : image->indices[i]);
+      if (index > max_index)
+         max_index = index;
+      bad += (index >= num_colors);
+   }
+
+   if (bad)
+      fprintf(stderr, "-!- %s: %zu indices not in palette of %u colors\n", path, bad, palette->num_colors);
+
+   struct png_plte plte;
+   memset(&plte, 0, sizeof(plte));
+   plte.num_colors = (num_colors > max_index ? num_colors : max_index + 1);
+   if (plte.num_colors > (1 << image->bpp))
+      plte.num_colors = 1 << image->bpp;
+
+   for (int i = 0; i < plte.num_colors && (uint32_t)i < num_colors; ++i) {
+      plte.colors[i] = (png_color){ palette->colors[i].r, palette->colors[i].g, palette->colors[i].b };
+      plte.alpha[i] = palette->colors[i].a;
+   }
+
+   // tRNS only needs to reach the last translucent entry
+   for (int i = 0; i < plte.num_colors; ++i) {
+      if (plte.alpha[i] != 255)
+         plte.num_alpha = i + 1;
+   }
+
+   // 4bpp rows of odd width don't start on a byte boundary, repack them
+   const size_t stride = (image->bpp == 4 ? (image->width + 1) / 2 : image->width);
+   uint8_t *packed = NULL;
+   const uint8_t **rows;
+   if (!(rows = malloc((image->height + 1) * sizeof(uint8_t*))))
+      return false;
+
+   if (image->bpp == 4 && (image->width & 1)) {
+      if (!(packed = calloc(image->height, stride))) {
+         free(rows);
+         return false;
+      }
+
+      for (size_t i = 0; i < count; ++i) {
+         const uint8_t index = (i & 1 ? image->indices[i / 2] >> 4 : image->indices[i / 2] & 0x0f);
+         const size_t x = i % image->width;
+         packed[(i / image->width) * stride + x / 2] |= (x & 1 ? index << 4 : index);
+      }
+   }
+
+   // stored bottom-up
+   for (uint32_t y = 0; y < image->height; ++y)
+      rows[y] = (packed ? packed : image->indices) + (size_t)(image->height - 1 - y) * stride;
+
+   const bool ret = write_png_rows(rows, image->width, image->height, image->bpp, &plte, path, options);
+   free(packed);
+   free(rows);
+   return ret;
+}
+
+bool
+write_image(const struct ccs_image *image, uint32_t p, const char *path, const struct export_options *options)
+{
+   assert(image && path && options);
+
+   if (options->png_palette)
+      return (image->width && image->height && write_image_indexed(image, p, path, options));
+
+   uint8_t *data;
+   const size_t size = image->width * image->height * 4; // RGBA 8bpp
+   if (!size || !(data = malloc(size)))
+      return false;
+
+   // write RGBA from palette, bottom-up
+   {
+      const struct ccs_palette *palette = &image->palettes[p];
+      const size_t bad = kernel_expand_rgba_flipped(data, image->indices, image->bpp, image->width, image->height, (const uint8_t*)palette->colors, palette->num_colors);
+      if (bad)
+         fprintf(stderr, "-!- %s: %zu indices not in palette of %u colors\n", path, bad, palette->num_colors);
+   }
+
+   const bool ret = write_png(data, image->width, image->height, path, options);
+   free(data);
+   return ret;
+}
+
+static bool
+emitter_output(struct emitter *emitter, const char *path, struct output *output)
+{
+   assert(emitter && path);
+
+   char *data;
+   size_t len;
+   return (emitter_take(emitter, &data, &len) && output_write(output, path, data, len));
+}
+
+bool
+write_mesh(const struct trimesh *tri, const char *texture, const char *name, const char *stem, struct output *output)
+{
+   assert(tri && texture && name && stem);
+
+   struct emitter e;
+   if (!emitter_open_memory(&e))
+      return false;
+
+   emit_str(&e, "# guccs (G.U Extractor)\r\n");
+   emit_str(&e, "# mesh: "); emit_str(&e, name); emit_str(&e, "\r\n\r\n");
+   emit_str(&e, "g "); emit_str(&e, name); emit_str(&e, "\r\n");
+   emit_str(&e, "usemtl texture\r\n");
+
+   // vertices
+   {
+      for (uint32_t i = 0; i < tri->num_vertices; ++i) {
+         emit(&e, "v ", 2);
+         emit_float(&e, tri->positions[i * 3 + 0]);
+         emit(&e, " ", 1);
+         emit_float(&e, tri->positions[i * 3 + 1]);
+         emit(&e, " ", 1);
+         emit_float(&e, tri->positions[i * 3 + 2]);
+         emit(&e, "\r\n", 2);
+      }
+   }
+
+   // coords
+   {
+      for (uint32_t i = 0; i < tri->num_vertices; ++i) {
+         emit(&e, "vt ", 3);
+         emit_float(&e, tri->coords[i * 2 + 0]);
+         emit(&e, " ", 1);
+         emit_float(&e, tri->coords[i * 2 + 1]);
+         emit(&e, "\r\n", 2);
+      }
+   }
+
+   // faces
+   {
+      for (uint32_t i = 0; i < tri->num_triangles; ++i) {
+         emit(&e, "f ", 2);
+         for (uint32_t v = 0; v < 3; ++v) {
+            emit_u32(&e, tri->indices[i * 3 + v] + 1);
+            emit(&e, "/", 1);
+            emit_u32(&e, tri->indices[i * 3 + v] + 1);
+            emit(&e, (v < 2 ? " " : "\r\n"), (v < 2 ? 1 : 2));
+         }
+      }
+   }
+
+   char path[1024];
+   snprintf(path, sizeof(path), "%s.obj", stem);
+
+   if (!emitter_output(&e, path, output))
+      return false;
+
+   if (!emitter_open_memory(&e))
+      return false;
+
+   // write material
+   {
+      emit_str(&e, "# guccs (G.U Extractor)\r\n");
+      emit_str(&e, "# mesh: "); emit_str(&e, name); emit_str(&e, "\r\n\r\n");
+      emit_str(&e, "newmtl texture\r\n");
+      emit_str(&e, "map_Kd "); emit_str(&e, texture); emit_str(&e, "\r\n");
+   }
+
+   snprintf(path, sizeof(path), "%s.mtl", stem);
+   return emitter_output(&e, path, output);
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,44 @@
+#ifndef __guhck_export__
+#define __guhck_export__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccs.h"
+#include "output.h"
+
+struct trimesh;
+
+enum list_format {
+   LIST_NONE,
+   LIST_TEXT,
+   LIST_JSON,
+};
+
+struct export_options {
+   int png_level; // zlib level, -1 for libpng default
+   int png_filters; // PNG_FILTER_* mask, -1 for libpng default
+   bool png_palette; // write indexed PNGs with the image palette instead of RGBA
+   bool all_palettes; // also write the image once per palette, named after the palette object
+   enum list_format list; // only list chunks, export nothing
+   bool stats; // print per archive statistics as JSON
+   bool incremental; // skip assets unchanged since the manifest in the output directory
+   uint32_t atlas; // max atlas size, 0 writes every image on its own
+   const char *store; // content addressed directory outputs are linked from, NULL writes them directly
+   enum output_backend io; // how the export stage writes files
+   struct output *output; // where finished files are queued, NULL writes them synchronously
+   struct tar *tar; // stream every archive writes its files into, NULL writes them to disk
+   struct ccs_filter filter;
+};
+
+/** Write top-down RGBA 8bpp pixels as PNG. */
+bool write_png(const uint8_t *rgba, uint32_t width, uint32_t height, const char *path, const struct export_options *options);
+
+/** Write image with palette p as RGBA PNG, or indexed with options->png_palette. */
+bool write_image(const struct ccs_image *image, uint32_t p, const char *path, const struct export_options *options);
+
+/** Write mesh name to <stem>.obj and its .mtl referencing texture through output. */
+bool write_mesh(const struct trimesh *tri, const char *texture, const char *name, const char *stem, struct output *output);
+
+#endif /* __guhck_export__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
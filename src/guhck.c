@@ -1,852 +1,1742 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <assert.h>
-#include <math.h>
-#include <zlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include <png.h>
 #include <chck/buffer/buffer.h>
+#include "ccs.h"
+#include "export.h"
+#include "kernels.h"
+#include "mesh.h"
+#include "hash.h"
+#include "manifest.h"
+#include "atlas.h"
+#include "store.h"
+#include "tar.h"
 
-struct ccs_color {
-   uint8_t r, g, b, a;
-};
+static bool
+make_dirs(const char *path)
+{
+   assert(path);
 
-struct ccs_palette {
-   uint32_t id;
-   uint32_t num_colors;
-   const struct ccs_color *colors;
-};
+   char tmp[1024];
+   if (snprintf(tmp, sizeof(tmp), "%s", path) >= (int)sizeof(tmp))
+      return false;
+
+   for (char *p = tmp + 1; *p; ++p) {
+      if (*p != '/')
+         continue;
+
+      *p = 0;
+      if (mkdir(tmp, 0755) != 0 && errno != EEXIST)
+         return false;
+      *p = '/';
+   }
+
+   return (mkdir(tmp, 0755) == 0 || errno == EEXIST);
+}
+
+static void
+archive_dir(char *dir, size_t size, const char *root, const char *path)
+{
+   assert(dir && root && path);
 
-struct ccs_image {
-   uint32_t id;
-   uint32_t pid;
-   // 6 bytes ???
-   uint32_t width, height;
-   // 10 bytes ???
-   uint32_t num_palettes;
-   const struct ccs_palette *palettes;
-   const uint8_t *indices;
+   // mirror the archive path under root, without extensions and with
+   // absolute/parent components neutralized, so every archive is unique
+   while (*path == '/') ++path;
+   while (!strncmp(path, "./", 2)) path += 2;
+
+   int len = snprintf(dir, size, "%s/%s", root, path);
+   if (len < 0 || (size_t)len >= size)
+      len = size - 1;
+
+   for (char *p = dir + strlen(root); (p = strstr(p, "/../")); p += 3)
+      memcpy(p + 1, "__", 2);
+
+   for (int i = 0; i < 2; ++i) {
+      char *ext = strrchr(dir, '.'), *sep = strrchr(dir, '/');
+      if (!ext || (sep && ext < sep) || ext == sep + 1)
+         break;
+
+      const bool gz = !strcmp(ext, ".gz");
+      *ext = 0;
+      if (!gz)
+         break;
+   }
+}
+
+struct parallel {
+   pthread_mutex_t mutex;
+   uint32_t next, count;
+   void (*fn)(uint32_t index, uint32_t worker, void *userdata);
+   void *userdata;
 };
 
-struct ccs_vec3f {
-   float x, y, z;
+struct parallel_thread {
+   struct parallel *parallel;
+   uint32_t worker;
 };
 
-struct ccs_vec2f {
-   float x, y;
+static void*
+parallel_worker(void *arg)
+{
+   assert(arg);
+   struct parallel_thread *thread = arg;
+   struct parallel *parallel = thread->parallel;
+
+   while (1) {
+      pthread_mutex_lock(&parallel->mutex);
+      const uint32_t i = parallel->next++;
+      pthread_mutex_unlock(&parallel->mutex);
+
+      if (i >= parallel->count)
+         break;
+
+      parallel->fn(i, thread->worker, parallel->userdata);
+   }
+
+   return NULL;
+}
+
+static void
+parallel_for(uint32_t jobs, uint32_t count, void (*fn)(uint32_t index, uint32_t worker, void *userdata), void *userdata)
+{
+   assert(fn);
+
+   if (jobs > count)
+      jobs = count;
+
+   // -j is not bounded, keep the thread table off the stack
+   pthread_t *threads = NULL;
+   struct parallel_thread *args = NULL;
+   if (jobs > 1 && (!(threads = calloc(jobs, sizeof(pthread_t))) || !(args = calloc(jobs, sizeof(struct parallel_thread))))) {
+      free(threads);
+      jobs = 1;
+   }
+
+   if (jobs <= 1) {
+      for (uint32_t i = 0; i < count; ++i)
+         fn(i, 0, userdata);
+      return;
+   }
+
+   struct parallel parallel;
+   memset(&parallel, 0, sizeof(parallel));
+   parallel.count = count;
+   parallel.fn = fn;
+   parallel.userdata = userdata;
+   pthread_mutex_init(&parallel.mutex, NULL);
+
+   // calling thread is worker 0
+   uint32_t started = 1;
+   for (; started < jobs; ++started) {
+      args[started] = (struct parallel_thread){ &parallel, started };
+      if (pthread_create(&threads[started], NULL, parallel_worker, &args[started]) != 0)
+         break;
+   }
+
+   args[0] = (struct parallel_thread){ &parallel, 0 };
+   parallel_worker(&args[0]);
+
+   for (uint32_t i = 1; i < started; ++i)
+      pthread_join(threads[i], NULL);
+
+   pthread_mutex_destroy(&parallel.mutex);
+   free(threads);
+   free(args);
+}
+
+struct task_log {
+   char *buf;
+   size_t len, mem;
 };
 
-struct ccs_tri3u {
-   uint32_t v[3];
+static void
+task_log_printf(struct task_log *log, const char *fmt, ...)
+{
+   assert(log && fmt);
+
+   va_list args;
+   va_start(args, fmt);
+   const int len = vsnprintf(NULL, 0, fmt, args);
+   va_end(args);
+
+   if (len <= 0)
+      return;
+
+   if (log->len + len + 1 > log->mem) {
+      const size_t mem = (log->len + len + 1) * 2;
+      char *buf;
+      if (!(buf = realloc(log->buf, mem)))
+         return;
+
+      log->buf = buf;
+      log->mem = mem;
+   }
+
+   va_start(args, fmt);
+   vsnprintf(log->buf + log->len, log->mem - log->len, fmt, args);
+   va_end(args);
+   log->len += len;
+}
+
+enum export_type {
+   EXPORT_MESH,
+   EXPORT_IMAGE,
+   EXPORT_ATLAS,
 };
 
-struct ccs_mesh {
-   uint32_t id;
-   uint32_t mid;
-   uint32_t num_triangles;
-   uint32_t num_vertices;
-   uint32_t *indices;
-   struct ccs_vec3f *vertices;
-   struct ccs_vec2f *coords;
+struct export_task {
+   enum export_type type;
+   uint32_t index;
+   uint32_t palette; // of the image
+   const char *name; // of the output
+   bool variant; // image written with another palette, named after it
+   bool reused; // already in the store, nothing was encoded
+   bool overwritten; // a later task writes the same files
+   bool failed;
+   uint64_t bytes; // written, only counted for stats
+   struct task_log log;
 };
 
-struct ccs_data {
+// texels of edge extrusion around each atlas image against filtering bleed
+#define ATLAS_PADDING 2
+
+struct atlas_entry {
    const char *name;
-   // 24 bytes ???
-   uint32_t num_files;
-   uint32_t num_objects;
-   // 32 bytes ???
-   const char **files;
-   const char **objects;
-   // 8 bytes ???
-   // { read until fileType != 0xcccc0005
-   //    uint32_t fileType;
-   //    uint32_t chunkSize;
-   //    void *data;
-   // }
-   // 12 bytes ???
-
-   uint32_t num_images;
-   const struct ccs_image *images;
-   uint32_t num_meshes;
-   const struct ccs_mesh *meshes;
+   uint32_t image;
+   bool tiled; // some mesh samples it outside [0,1], stays a texture of its own
+};
+
+struct atlas {
+   struct atlas_entry *entries; // sorted by name
+   struct atlas_rect *rects; // one per entry, padding included
+   uint32_t num_entries;
+   struct atlas_page *pages;
+   uint8_t **pixels; // RGBA per page, top-down like the PNG
+   uint32_t num_pages;
 };
 
+static int
+atlas_entry_cmp(const void *a, const void *b)
+{
+   const struct atlas_entry *ea = a, *eb = b;
+   return strcmp(ea->name, eb->name);
+}
+
+static const struct atlas_rect*
+atlas_find(const struct atlas *atlas, const char *name)
+{
+   assert(atlas && name);
+
+   const struct atlas_entry key = { .name = name };
+   const struct atlas_entry *entry;
+   if (!(entry = bsearch(&key, atlas->entries, atlas->num_entries, sizeof(struct atlas_entry), atlas_entry_cmp)))
+      return NULL;
+
+   const struct atlas_rect *rect = &atlas->rects[entry - atlas->entries];
+   return (rect->page != ATLAS_NO_PAGE ? rect : NULL);
+}
+
 static bool
-write_image(const struct ccs_image *image, uint32_t p, const char *path)
+coords_in_unit(const uint8_t *coords, uint32_t num_vertices)
 {
-   assert(image && path);
+   assert(coords || !num_vertices);
 
-   FILE *f;
-   if (!(f = fopen(path, "wb")))
-      return false;
+   // checked on the 8.8 fixed point payload, 0..1 is 0..256, no need to decode the mesh
+   for (uint32_t i = 0; i < num_vertices * 2; ++i) {
+      const int16_t v = (int16_t)(coords[i * 2] | coords[i * 2 + 1] << 8);
+      if (v < 0 || v > 256)
+         return false;
+   }
+
+   return true;
+}
+
+static void
+atlas_remap(const struct atlas *atlas, const struct atlas_rect *rect, float *coords, uint32_t num_vertices)
+{
+   assert(atlas && rect && (coords || !num_vertices));
+
+   // v points up in the OBJ while atlas rows run top-down
+   const struct atlas_page *page = &atlas->pages[rect->page];
+   const float x = rect->x + ATLAS_PADDING, y = rect->y + ATLAS_PADDING;
+   const float w = rect->width - ATLAS_PADDING * 2, h = rect->height - ATLAS_PADDING * 2;
+   for (uint32_t i = 0; i < num_vertices; ++i) {
+      coords[i * 2 + 0] = (x + coords[i * 2 + 0] * w) / page->width;
+      coords[i * 2 + 1] = 1.0f - (y + (1.0f - coords[i * 2 + 1]) * h) / page->height;
+   }
+}
+
+static bool
+atlas_blit(const struct atlas *atlas, const struct atlas_rect *rect, const struct ccs_image *image, const char *name)
+{
+   assert(atlas && rect && image && name);
 
    uint8_t *data;
-   const size_t size = image->width * image->height * 4; // RGBA 8bpp
-   if (!size || !(data = calloc(1, size)))
+   if (!(data = malloc((size_t)image->width * image->height * 4)))
       return false;
 
-   // write RGBA from palette
-   {
-      const struct ccs_palette *palette = &image->palettes[p];
-      for (uint32_t i = 0; i < image->height * image->width; ++i) {
-         uint8_t index = image->indices[i];
-         if (index >= palette->num_colors) {
-            printf("-!- Index not in palette: %u, %u\n", index, palette->num_colors);
-            continue;
-         }
-         data[i * 4 + 0] = palette->colors[index].r;
-         data[i * 4 + 1] = palette->colors[index].g;
-         data[i * 4 + 2] = palette->colors[index].b;
-         data[i * 4 + 3] = palette->colors[index].a;
+   const struct ccs_palette *palette = &image->palettes[0];
+   const size_t bad = kernel_expand_rgba_flipped(data, image->indices, image->bpp, image->width, image->height, (const uint8_t*)palette->colors, palette->num_colors);
+   if (bad)
+      fprintf(stderr, "-!- %s: %zu indices not in palette of %u colors\n", name, bad, palette->num_colors);
+
+   // rects never overlap, so workers blit into the same page without locking
+   const struct atlas_page *page = &atlas->pages[rect->page];
+   const size_t row = (size_t)image->width * 4;
+   for (uint32_t y = 0; y < rect->height; ++y) {
+      const int64_t sy = (int64_t)y - ATLAS_PADDING;
+      const uint8_t *src = data + (sy < 0 ? 0 : (sy >= image->height ? image->height - 1 : sy)) * row;
+      uint8_t *dst = atlas->pixels[rect->page] + ((size_t)(rect->y + y) * page->width + rect->x) * 4;
+
+      for (uint32_t x = 0; x < ATLAS_PADDING; ++x) {
+         memcpy(dst + x * 4, src, 4);
+         memcpy(dst + ATLAS_PADDING * 4 + row + x * 4, src + row - 4, 4);
       }
+
+      memcpy(dst + ATLAS_PADDING * 4, src, row);
    }
 
-   // invert
-   {
-      for (uint32_t i = 0; i * 2 < image->height; ++i) {
-         uint32_t index1 = i * image->width * 4;
-         uint32_t index2 = (image->height - 1 - i) * image->width * 4;
-         for (uint32_t i2 = image->width * 4; i2 > 0; --i2) {
-            unsigned char temp = data[index1];
-            data[index1] = data[index2];
-            data[index2] = temp;
-            ++index1; ++index2;
-         }
-      }
+   free(data);
+   return true;
+}
+
+static void
+atlas_release(struct atlas *atlas)
+{
+   assert(atlas);
+
+   for (uint32_t p = 0; atlas->pixels && p < atlas->num_pages; ++p)
+      free(atlas->pixels[p]);
+
+   free(atlas->pixels);
+   free(atlas->pages);
+   free(atlas->rects);
+   free(atlas->entries);
+   memset(atlas, 0, sizeof(struct atlas));
+}
+
+struct export_stage {
+   const struct ccs_data *data;
+   const struct export_options *options;
+   const char *dir;
+   struct export_task *tasks;
+   const struct atlas *atlas; // NULL unless exporting atlases
+   uint64_t store_seed; // options the stored assets were encoded with
+   bool verbose;
+};
+
+static uint64_t
+file_size(const char *path)
+{
+   assert(path);
+   struct stat st;
+   return (stat(path, &st) == 0 ? (uint64_t)st.st_size : 0);
+}
+
+static bool
+encode_mesh(struct export_task *task, const struct export_stage *stage, const struct ccs_mesh *mesh, const char *texture, const struct atlas_rect *rect, const char *stem, struct output *output)
+{
+   assert(task && stage && mesh && texture && stem);
+
+   const char *name = stage->data->objects[mesh->id];
+
+   // geometry only lives while its mesh is exported
+   struct ccs_geometry geometry;
+   if (!ccs_mesh_decode(mesh, &geometry))
+      return false;
+
+   struct trimesh tri;
+   const bool built = trimesh_from_strips(&tri, &geometry.vertices[0].x, &geometry.coords[0].x, geometry.indices, geometry.num_vertices);
+   ccs_geometry_release(&geometry);
+
+   if (!built || !trimesh_optimize(&tri)) {
+      trimesh_release(&tri);
+      return false;
    }
 
-   // write png
-   {
-      png_structp png;
-      if (!(png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL)))
-         return false;
+   if (tri.num_skipped_strips)
+      task_log_printf(&task->log, "-!- %s: skipped %u strips with unknown winding\n", name, tri.num_skipped_strips);
 
-      png_infop info;
-      if (!(info = png_create_info_struct(png)))
-         return false;
+   if (rect)
+      atlas_remap(stage->atlas, rect, tri.coords, tri.num_vertices);
+
+   const bool ret = write_mesh(&tri, texture, name, stem, output);
+   trimesh_release(&tri);
+   return ret;
+}
 
-      if (setjmp(png_jmpbuf(png)))
+static bool
+store_mesh(struct export_task *task, const struct export_stage *stage, const struct ccs_mesh *mesh, const char *texture, const char *stem)
+{
+   assert(task && stage && mesh && texture && stem);
+
+   // name and texture are written next to the geometry
+   const char *name = stage->data->objects[mesh->id];
+   struct store_key key = { stage->store_seed, stage->store_seed };
+   store_key_add(&key, "mesh", 4);
+   store_key_add(&key, name, strlen(name) + 1);
+   store_key_add(&key, texture, strlen(texture) + 1);
+   // keyed by the payload as stored, reused meshes are never decoded
+   store_key_add(&key, mesh->positions, mesh->num_vertices * 6);
+   store_key_add(&key, mesh->strips, mesh->num_vertices * 4);
+   store_key_add(&key, mesh->coords, mesh->num_vertices * 4);
+
+   char obj[1024], mtl[1024];
+   if (!store_path(obj, sizeof(obj), stage->options->store, &key, ".obj") ||
+       !store_path(mtl, sizeof(mtl), stage->options->store, &key, ".mtl"))
+      return false;
+
+   // the .obj is committed last, it being there means the pair is complete
+   if (access(obj, F_OK) == 0) {
+      task->reused = true;
+   } else {
+      char tmp[1024], tmp_obj[1100], tmp_mtl[1100];
+      if (!store_temp(tmp, sizeof(tmp), obj))
          return false;
 
-      png_set_IHDR(png, info, image->width, image->height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+      snprintf(tmp_obj, sizeof(tmp_obj), "%s.obj", tmp);
+      snprintf(tmp_mtl, sizeof(tmp_mtl), "%s.mtl", tmp);
+      // written synchronously, the commit needs the files complete
+      const bool ok = (encode_mesh(task, stage, mesh, texture, NULL, tmp, NULL) && store_commit(tmp_mtl, mtl) && store_commit(tmp_obj, obj));
+      remove(tmp_obj);
+      remove(tmp_mtl);
+      remove(tmp);
 
-      png_byte **rows;
-      if (!(rows = png_malloc(png, image->height * sizeof(png_byte*))))
+      if (!ok)
          return false;
+   }
 
-      for (uint32_t y = 0; y < image->height; ++y) {
-         png_byte *row = png_malloc(png, image->width * 4);
-         rows[y] = row;
-         for (uint32_t x = 0; x < image->width; ++x) {
-            uint32_t i = image->width * y + x;
-            *row++ = data[i * 4 + 0];
-            *row++ = data[i * 4 + 1];
-            *row++ = data[i * 4 + 2];
-            *row++ = data[i * 4 + 3];
-         }
-      }
+   char path[1100];
+   snprintf(path, sizeof(path), "%s.obj", stem);
+   if (!store_link(obj, path))
+      return false;
 
-      png_init_io(png, f);
-      png_set_rows(png, info, rows);
-      png_write_png(png, info, PNG_TRANSFORM_IDENTITY, NULL);
+   snprintf(path, sizeof(path), "%s.mtl", stem);
+   return store_link(mtl, path);
+}
 
-      for (uint32_t y = 0; y < image->height; ++y)
-         png_free(png, rows[y]);
+static bool
+store_image(struct export_task *task, const struct export_stage *stage, const struct ccs_image *image, const char *path)
+{
+   assert(task && stage && image && path);
+
+   // output name plays no part in the PNG, images are shared across names
+   const struct ccs_palette *palette = &image->palettes[task->palette];
+   const uint32_t header[3] = { image->width, image->height, image->bpp };
+   struct store_key key = { stage->store_seed, stage->store_seed };
+   store_key_add(&key, "image", 5);
+   store_key_add(&key, header, sizeof(header));
+   store_key_add(&key, image->indices, ((size_t)image->width * image->height * image->bpp + 7) / 8);
+   store_key_add(&key, palette->colors, palette->num_colors * sizeof(struct ccs_color));
+
+   char stored[1024];
+   if (!store_path(stored, sizeof(stored), stage->options->store, &key, ".png"))
+      return false;
 
-      png_free(png, rows);
-      png_destroy_write_struct(&png, &info);
+   if (access(stored, F_OK) == 0) {
+      task->reused = true;
+   } else {
+      char tmp[1024], tmp_png[1100];
+      if (!store_temp(tmp, sizeof(tmp), stored))
+         return false;
+
+      // encoded next to the placeholder, mkstemp would leave the PNG 0600
+      snprintf(tmp_png, sizeof(tmp_png), "%s.png", tmp);
+      struct export_options sync = *stage->options;
+      sync.output = NULL;
+      const bool ok = (write_image(image, task->palette, tmp_png, &sync) && store_commit(tmp_png, stored));
+      remove(tmp_png);
+      remove(tmp);
+
+      if (!ok)
+         return false;
    }
 
-   free(data);
-   fclose(f);
-   return true;
+   return store_link(stored, path);
 }
 
 static void
-resolve_tristrip(struct ccs_tri3u *faces, uint32_t *f, uint32_t start, uint32_t size, uint32_t type)
-{
-   assert(faces && f);
-
-   for (uint32_t i = 0; i < size - 2; ++i) {
-      switch (type) {
-         case 1:
-            if (i % 2 == 1) {
-               faces[*f].v[0] = start + i + 1;
-               faces[*f].v[1] = start + i;
-               faces[*f].v[2] = start + i + 2;
-               *f = *f + 1;
-            } else {
-               faces[*f].v[0] = start + i;
-               faces[*f].v[1] = start + i + 1;
-               faces[*f].v[2] = start + i + 2;
-               *f = *f + 1;
+export_worker(uint32_t index, uint32_t worker, void *userdata)
+{
+   (void)worker;
+   assert(userdata);
+   struct export_stage *stage = userdata;
+   struct export_task *task = &stage->tasks[index];
+   const struct ccs_data *data = stage->data;
+
+   switch (task->type) {
+      case EXPORT_MESH:
+         {
+            const struct ccs_mesh *mesh = &data->meshes[task->index];
+
+            if (stage->verbose) {
+               task_log_printf(&task->log, "• %s\n", data->objects[mesh->id]);
+               task_log_printf(&task->log, "    • %s\n", data->objects[mesh->mid]);
             }
-            break;
 
-         case 2:
-            if (i % 2 == 1) {
-               faces[*f].v[0] = start + i;
-               faces[*f].v[1] = start + i + 1;
-               faces[*f].v[2] = start + i + 2;
-               *f = *f + 1;
+            if (task->overwritten)
+               break;
+
+            char texture[1024];
+            const struct atlas_rect *rect = (stage->atlas ? atlas_find(stage->atlas, data->objects[mesh->mid + 1]) : NULL);
+            if (rect)
+               snprintf(texture, sizeof(texture), "atlas%u.png", rect->page);
+            else
+               snprintf(texture, sizeof(texture), "%s.png", data->objects[mesh->mid + 1]);
+
+            char stem[1024];
+            snprintf(stem, sizeof(stem), "%s/%s", stage->dir, data->objects[mesh->id]);
+
+            // remapped coords depend on the whole atlas, those meshes bypass the store
+            const bool stored = (stage->options->store && !rect);
+            if (stored)
+               task->failed = !store_mesh(task, stage, mesh, texture, stem);
+            else
+               task->failed = !encode_mesh(task, stage, mesh, texture, rect, stem, stage->options->output);
+
+            // queued writes are counted by the output once they land
+            if (stage->options->stats && stored && !task->failed) {
+               char buf[1100];
+               snprintf(buf, sizeof(buf), "%s.obj", stem);
+               task->bytes += file_size(buf);
+               snprintf(buf, sizeof(buf), "%s.mtl", stem);
+               task->bytes += file_size(buf);
+            }
+         }
+         break;
+
+      case EXPORT_IMAGE:
+         {
+            const struct ccs_image *image = &data->images[task->index];
+
+            if (stage->verbose && !task->variant) {
+               task_log_printf(&task->log, "• %s (%ux%u)\n", data->objects[image->id], image->width, image->height);
+               for (uint32_t p = 0; p < image->num_palettes; ++p) {
+                  task_log_printf(&task->log, "    • %s palette with num colors %u\n",
+                        (image->palettes[p].id < data->num_objects ? data->objects[image->palettes[p].id] : "?"),
+                        image->palettes[p].num_colors);
+               }
+            }
+
+            if (task->overwritten)
+               break;
+
+            const struct atlas_rect *rect;
+            if (stage->atlas && !task->variant && (rect = atlas_find(stage->atlas, task->name))) {
+               task->failed = !atlas_blit(stage->atlas, rect, image, task->name);
+               break;
+            }
+
+            // variants share the decoded indices read-only
+            char buf[1024];
+            snprintf(buf, sizeof(buf), "%s/%s.png", stage->dir, task->name);
+            if (stage->options->store) {
+               task->failed = !store_image(task, stage, image, buf);
+               if (stage->options->stats && !task->failed)
+                  task->bytes = file_size(buf);
             } else {
-               faces[*f].v[0] = start + i + 1;
-               faces[*f].v[1] = start + i;
-               faces[*f].v[2] = start + i + 2;
-               *f = *f + 1;
+               task->failed = !write_image(image, task->palette, buf, stage->options);
             }
-            break;
+         }
+         break;
 
-         default:
-            fprintf(stderr, "failed to resolve tristrip\n");
-            abort();
-      }
+      case EXPORT_ATLAS:
+         {
+            const struct atlas_page *page = &stage->atlas->pages[task->index];
+
+            char buf[1024];
+            snprintf(buf, sizeof(buf), "%s/atlas%u.png", stage->dir, task->index);
+            task->failed = !write_png(stage->atlas->pixels[task->index], page->width, page->height, buf, stage->options);
+         }
+         break;
    }
 }
 
+static int
+export_task_cmp(const void *a, const void *b)
+{
+   const struct export_task *ta = *(const struct export_task**)a, *tb = *(const struct export_task**)b;
+
+   int ret;
+   if (ta->type != tb->type)
+      return (ta->type < tb->type ? -1 : 1);
+   if ((ret = strcmp(ta->name, tb->name)))
+      return ret;
+   return (ta - tb < 0 ? -1 : (ta - tb > 0));
+}
+
 static bool
-write_mesh(const struct ccs_mesh *mesh, const char *texture, const char *name, const char *path)
+mark_overwritten(struct export_task *tasks, uint32_t num_tasks)
 {
-   assert(mesh && texture && name && path);
+   assert(tasks || !num_tasks);
 
-   FILE *f;
-   if (!(f = fopen(path, "w")))
+   // sequential export let the last asset with a given name win,
+   // keep that deterministic when the writes race each other
+   struct export_task **sorted;
+   if (!(sorted = calloc(num_tasks, sizeof(struct export_task*))))
       return false;
 
-   fprintf(f, "# guccs (G.U Extractor)\r\n");
-   fprintf(f, "# mesh: %s\r\n\r\n", name);
-   fprintf(f, "g %s\r\n", name);
-   fprintf(f, "usemtl texture\r\n");
+   for (uint32_t i = 0; i < num_tasks; ++i)
+      sorted[i] = &tasks[i];
 
-   // vertices
-   {
-      for (uint32_t i = 0; i < mesh->num_vertices; ++i)
-         fprintf(f, "v %f %f %f\r\n", mesh->vertices[i].x, mesh->vertices[i].y, mesh->vertices[i].z);
+   qsort(sorted, num_tasks, sizeof(struct export_task*), export_task_cmp);
+
+   for (uint32_t i = 0; i + 1 < num_tasks; ++i)
+      sorted[i]->overwritten = (sorted[i]->type == sorted[i + 1]->type && !strcmp(sorted[i]->name, sorted[i + 1]->name));
+
+   free(sorted);
+   return true;
+}
+
+static void
+list_chunks_text(struct task_log *log, const struct ccs_data *data, const char *path)
+{
+   assert(log && data && path);
+
+   task_log_printf(log, "%s: %s\n", path, data->name);
+   task_log_printf(log, "  %-10s %-10s %-12s %s\n", "offset", "size", "type", "object");
+   for (uint32_t i = 0; i < data->num_chunks; ++i) {
+      const struct ccs_chunk *chunk = &data->chunks[i];
+      task_log_printf(log, "  0x%08zx %-10zu %-12s %s\n", chunk->offset, chunk->size, ccs_chunk_type_name(chunk->type),
+            (chunk->id != CCS_NO_ID ? data->objects[chunk->id] : "-"));
    }
+}
 
-   // coords
-   {
-      for (uint32_t i = 0; i < mesh->num_vertices; ++i)
-         fprintf(f, "vt %f %f\r\n", mesh->coords[i].x, mesh->coords[i].y);
+static void
+json_string(struct task_log *log, const char *str)
+{
+   assert(log && str);
+
+   task_log_printf(log, "\"");
+   for (const unsigned char *c = (const unsigned char*)str; *c; ++c) {
+      if (*c == '"' || *c == '\\')
+         task_log_printf(log, "\\%c", *c);
+      else if (*c < 0x20 || *c >= 0x7f)
+         task_log_printf(log, "\\u%04x", *c);
+      else
+         task_log_printf(log, "%c", *c);
    }
+   task_log_printf(log, "\"");
+}
 
-   // faces
-   {
-      struct ccs_tri3u *faces;
-      if (!(faces = calloc(mesh->num_triangles, sizeof(struct ccs_tri3u))))
-         return false;
+static void
+list_chunks_json(struct task_log *log, const struct ccs_data *data, const char *path)
+{
+   assert(log && data && path);
+
+   task_log_printf(log, "{\"path\":");
+   json_string(log, path);
+   task_log_printf(log, ",\"name\":");
+   json_string(log, data->name);
+   task_log_printf(log, ",\"chunks\":[");
+   for (uint32_t i = 0; i < data->num_chunks; ++i) {
+      const struct ccs_chunk *chunk = &data->chunks[i];
+      task_log_printf(log, "%s{\"offset\":%zu,\"size\":%zu,\"type\":\"0x%08x\",\"kind\":\"%s\",\"object\":",
+            (i ? "," : ""), chunk->offset, chunk->size, chunk->type, ccs_chunk_type_name(chunk->type));
+      if (chunk->id != CCS_NO_ID)
+         json_string(log, data->objects[chunk->id]);
+      else
+         task_log_printf(log, "null");
+      task_log_printf(log, "}");
+   }
+   task_log_printf(log, "]}\n");
+}
 
-      for (uint32_t ff = 0, i = 0, size = 0, started = 0; i < mesh->num_vertices; ++i) {
-         if (started && mesh->indices[i] == 0) {
-            ++size;
-         } else if (started && mesh->indices[i] != 0) {
-            started = 0;
-            resolve_tristrip(faces, &ff, i - size, size, mesh->indices[i - size]);
-            size = 0;
-         }
+static bool
+atlas_build(struct atlas *atlas, const struct ccs_data *data, const struct export_task *tasks, uint32_t num_tasks, uint32_t max_size)
+{
+   assert(atlas && data && (tasks || !num_tasks) && max_size);
+   memset(atlas, 0, sizeof(struct atlas));
 
-         if (mesh->indices[i] != 0 && !started) {
-            started = 1;
-            size += 2;
-            ++i;
-         }
+   if (!(atlas->entries = calloc(num_tasks + 1, sizeof(struct atlas_entry))) ||
+       !(atlas->rects = calloc(num_tasks + 1, sizeof(struct atlas_rect))))
+      return false;
 
-         if (i == mesh->num_vertices - 1)
-            resolve_tristrip(faces, &ff, (i - size) + 1, size, mesh->indices[(i - size) + 1]);
-      }
+   for (uint32_t i = 0; i < num_tasks; ++i) {
+      if (tasks[i].type == EXPORT_IMAGE && !tasks[i].variant && !tasks[i].overwritten)
+         atlas->entries[atlas->num_entries++] = (struct atlas_entry){ .name = tasks[i].name, .image = tasks[i].index };
+   }
 
-      for (uint32_t i = 0; i < mesh->num_triangles; ++i) {
-         fprintf(f, "f %u/%u %u/%u %u/%u\r\n",
-               faces[i].v[0] + 1,
-               faces[i].v[0] + 1,
-               faces[i].v[1] + 1,
-               faces[i].v[1] + 1,
-               faces[i].v[2] + 1,
-               faces[i].v[2] + 1);
-      }
+   qsort(atlas->entries, atlas->num_entries, sizeof(struct atlas_entry), atlas_entry_cmp);
+
+   // wrapping coordinates would sample neighbours once packed
+   for (uint32_t i = 0; i < num_tasks; ++i) {
+      if (tasks[i].type != EXPORT_MESH || tasks[i].overwritten)
+         continue;
 
-      free(faces);
+      const struct ccs_mesh *mesh = &data->meshes[tasks[i].index];
+      const struct atlas_entry key = { .name = data->objects[mesh->mid + 1] };
+      struct atlas_entry *entry;
+      if ((entry = bsearch(&key, atlas->entries, atlas->num_entries, sizeof(struct atlas_entry), atlas_entry_cmp)) &&
+          !coords_in_unit(mesh->coords, mesh->num_vertices))
+         entry->tiled = true;
    }
 
-   fclose(f);
+   // zero sized rects are left unpacked
+   for (uint32_t i = 0; i < atlas->num_entries; ++i) {
+      const struct ccs_image *image = &data->images[atlas->entries[i].image];
+      if (!atlas->entries[i].tiled && image->width && image->height)
+         atlas->rects[i] = (struct atlas_rect){ .width = image->width + ATLAS_PADDING * 2, .height = image->height + ATLAS_PADDING * 2 };
+   }
 
-   char mtl[256];
-   snprintf(mtl, sizeof(mtl) - 1, "%s.mtl", name);
+   if (!atlas_pack(atlas->rects, atlas->num_entries, max_size, &atlas->pages, &atlas->num_pages))
+      return false;
 
-   if (!(f = fopen(mtl, "w")))
+   if (atlas->num_pages && !(atlas->pixels = calloc(atlas->num_pages, sizeof(uint8_t*))))
       return false;
 
-   // write material
-   {
-      fprintf(f, "# guccs (G.U Extractor)\r\n");
-      fprintf(f, "# mesh: %s\r\n\r\n", name);
-      fprintf(f, "newmtl texture\r\n");
-      fprintf(f, "map_Kd %s\r\n", texture);
+   for (uint32_t p = 0; p < atlas->num_pages; ++p) {
+      if (!(atlas->pixels[p] = calloc((size_t)atlas->pages[p].width * atlas->pages[p].height, 4)))
+         return false;
    }
 
-   fclose(f);
    return true;
 }
 
-static bool
-read_image(struct chck_buffer *buffer, struct ccs_image *image)
+static void
+atlas_json(struct task_log *log, const struct atlas *atlas)
 {
-   assert(buffer && image);
+   assert(log && atlas);
 
-   chck_buffer_read_int(&image->id, sizeof(image->id), buffer); // ID?
-   chck_buffer_read_int(&image->pid, sizeof(image->pid), buffer); // Paletted ID?
+   task_log_printf(log, "{\"padding\":%u,\"atlases\":[", ATLAS_PADDING);
+   for (uint32_t p = 0; p < atlas->num_pages; ++p) {
+      task_log_printf(log, "%s{\"file\":\"atlas%u.png\",\"width\":%u,\"height\":%u}",
+            (p ? "," : ""), p, atlas->pages[p].width, atlas->pages[p].height);
+   }
 
-   // our IDs start from zero
-   image->id -= 1;
-   image->pid -= 1;
+   // x and y are the top-left texel of the image, padding excluded
+   task_log_printf(log, "],\"images\":[");
+   for (uint32_t i = 0; i < atlas->num_entries; ++i) {
+      const struct atlas_rect *rect = &atlas->rects[i];
+      task_log_printf(log, "%s{\"name\":", (i ? "," : ""));
+      json_string(log, atlas->entries[i].name);
+      if (rect->page != ATLAS_NO_PAGE) {
+         task_log_printf(log, ",\"atlas\":%u,\"x\":%u,\"y\":%u,\"width\":%u,\"height\":%u}", rect->page,
+               rect->x + ATLAS_PADDING, rect->y + ATLAS_PADDING, rect->width - ATLAS_PADDING * 2, rect->height - ATLAS_PADDING * 2);
+      } else {
+         task_log_printf(log, ",\"atlas\":null}");
+      }
+   }
+   task_log_printf(log, "]}\n");
+}
 
-#if 1
-   uint8_t type;
-   {
-      union {
-         uint32_t tmp32;
-         uint8_t tmp8;
-      } u;
-      chck_buffer_read_int(&u.tmp32, sizeof(u.tmp32), buffer); // ID?
-      printf("1: %u\n", u.tmp32);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("2: %u\n", u.tmp8);
-      chck_buffer_read_int(&type, sizeof(type), buffer); // ???
-      printf("3: %u\n", type);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("4: %u\n", u.tmp8);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("5: %u\n", u.tmp8);
-   }
-#else
-   chck_buffer_seek(buffer, 8, SEEK_CUR); // ???
-#endif
+static uint64_t
+options_hash(const struct export_options *options)
+{
+   assert(options);
+
+   // bump the version whenever the same chunks would export differently
+   char buf[256];
+   int len = snprintf(buf, sizeof(buf), "v1 png_level=%d png_filters=%d", options->png_level, options->png_filters);
+   if (options->png_palette)
+      len += snprintf(buf + len, sizeof(buf) - len, " png_palette");
+   if (options->all_palettes)
+      len += snprintf(buf + len, sizeof(buf) - len, " all_palettes");
+   if (options->atlas)
+      len += snprintf(buf + len, sizeof(buf) - len, " atlas=%u", options->atlas);
+   return hash64(buf, len, 0);
+}
 
-   uint8_t exponent;
-   chck_buffer_read_int(&exponent, sizeof(exponent), buffer);
-   image->width = (uint32_t)pow(2.0, exponent);
-   chck_buffer_read_int(&exponent, sizeof(exponent), buffer);
-   image->height = (uint32_t)pow(2.0, exponent);
-
-#if 0
-   {
-      union {
-         uint8_t tmp8;
-      };
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("1: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("2: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("3: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // channels?
-      printf("4: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("5: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("6: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("7: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("8: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("9: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(u.tmp8), buffer); // ???
-      printf("10: %u\n", tmp);
-   }
-#else
-   chck_buffer_seek(buffer, 10, SEEK_CUR); // ???
-#endif
+struct asset_key {
+   uint32_t kind, chunk;
+   const char *name;
+};
 
-   uint8_t *indices;
-   const size_t size = image->width * image->height;
-   if (!size || !(indices = calloc(1, size)))
-      return false;
+static int
+asset_key_cmp(const void *a, const void *b)
+{
+   const struct asset_key *ka = a, *kb = b;
+
+   int ret;
+   if (ka->kind != kb->kind)
+      return (ka->kind < kb->kind ? -1 : 1);
+   if ((ret = strcmp(ka->name, kb->name)))
+      return ret;
+   return (ka->chunk < kb->chunk ? -1 : ka->chunk > kb->chunk);
+}
 
-   if (type == 19) {
-      // 32bit palette
-      chck_buffer_read(indices, size, 1, buffer);
-   } else if (type == 20) {
-      // 16bit palette
-      for (uint32_t i = 0, index = 0; i < size; ++i) {
-         chck_buffer_read_int(&index, sizeof(index), buffer);
-         indices[i++] = index % 16;
-         indices[i] = index / 16;
-         if (indices[i] == 16 || indices[i - 1] == 16) {
-            printf("(%u, %u) %u\n", indices[i - 1], indices[i], index);
-            return false;
-         }
-      }
+static bool
+outputs_exist(uint32_t kind, const char *name, const char *dir)
+{
+   assert(name && dir);
+
+   char path[1024];
+   if (kind == CCS_FILTER_MESH) {
+      snprintf(path, sizeof(path), "%s/%s.obj", dir, name);
+      if (access(path, F_OK) != 0)
+         return false;
+      snprintf(path, sizeof(path), "%s/%s.mtl", dir, name);
    } else {
-      printf("-!- unknown palette\n");
+      snprintf(path, sizeof(path), "%s/%s.png", dir, name);
    }
 
-   image->indices = (const uint8_t*)indices;
-   return true;
+   return (access(path, F_OK) == 0);
 }
 
 static bool
-read_palette(struct chck_buffer *buffer, struct ccs_palette *palette, size_t size)
+plan_incremental(const struct ccs_data *data, const uint8_t *archive, const struct manifest *manifest, const char *dir, uint64_t *hashes, bool *skip, uint32_t *out_unchanged)
 {
-   assert(buffer && palette);
+   assert(data && archive && manifest && dir && hashes && skip && out_unchanged);
+
+   // names end up in file names and material references,
+   // renaming an object invalidates every asset of the archive
+   uint64_t names = manifest->options;
+   for (uint32_t i = 0; i < data->num_objects; ++i)
+      names = hash64(data->objects[i], strlen(data->objects[i]) + 1, names);
 
-   struct ccs_color *colors;
-   const size_t num_colors = (size - 20) / 4;
-   if (!num_colors || !(colors = calloc(num_colors, sizeof(struct ccs_color))))
+   struct asset_key *keys;
+   if (!(keys = calloc(data->num_chunks + 1, sizeof(struct asset_key))))
       return false;
 
-   chck_buffer_read_int(&palette->id, sizeof(palette->id), buffer); // ID?
-   chck_buffer_seek(buffer, 16, SEEK_CUR); // ???
+   uint32_t num_keys = 0, first_palette = 0;
+   for (uint32_t c = 0; c < data->num_chunks; ++c) {
+      const struct ccs_chunk *chunk = &data->chunks[c];
 
-   // our IDs start from zero
-   palette->id -= 1;
+      uint32_t kind;
+      switch (chunk->type) {
+         case 0xcccc0800: // MESH
+            kind = CCS_FILTER_MESH;
+            hashes[c] = hash64(archive + chunk->offset, chunk->size, names);
+            break;
+         case 0xcccc0300: // IMAGE
+            {
+               // image owns the palettes that preceded it
+               kind = CCS_FILTER_IMAGE;
+               hashes[c] = hash64(archive + chunk->offset, chunk->size, names);
+               for (uint32_t p = first_palette; p < c; ++p) {
+                  if (data->chunks[p].type == 0xcccc0400)
+                     hashes[c] = hash64(archive + data->chunks[p].offset, data->chunks[p].size, hashes[c]);
+               }
+               first_palette = c + 1;
+            }
+            break;
+         default:
+            continue;
+      }
 
-   for (uint32_t i = 0; i < num_colors; ++i) {
-      chck_buffer_read_int(&colors[i].r, sizeof(colors[i].r), buffer);
-      chck_buffer_read_int(&colors[i].g, sizeof(colors[i].g), buffer);
-      chck_buffer_read_int(&colors[i].b, sizeof(colors[i].b), buffer);
-      chck_buffer_read_int(&colors[i].a, sizeof(colors[i].a), buffer);
-      if (colors[i].a <= 128) colors[i].a = (colors[i].a * 255) / 128;
+      if (chunk->id != CCS_NO_ID)
+         keys[num_keys++] = (struct asset_key){ .kind = kind, .chunk = c, .name = data->objects[chunk->id] };
    }
 
-   palette->num_colors = num_colors;
-   palette->colors = colors;
+   // the last chunk of a name is the one that ends up on disk, it decides for all of them
+   qsort(keys, num_keys, sizeof(struct asset_key), asset_key_cmp);
+
+   uint32_t unchanged = 0;
+   for (uint32_t i = 0; i < num_keys;) {
+      uint32_t end = i + 1;
+      while (end < num_keys && keys[end].kind == keys[i].kind && !strcmp(keys[end].name, keys[i].name))
+         ++end;
+
+      const struct asset_key *last = &keys[end - 1];
+      const struct manifest_entry *entry = manifest_find(manifest, last->kind, last->name);
+      const bool same = (entry && entry->hash == hashes[last->chunk] && outputs_exist(last->kind, last->name, dir));
+      unchanged += same;
+
+      for (; i < end; ++i)
+         skip[keys[i].chunk] = same;
+   }
+
+   free(keys);
+   *out_unchanged = unchanged;
    return true;
 }
 
-static bool
-read_mesh(struct chck_buffer *buffer, struct ccs_mesh *mesh)
-{
-   assert(buffer && mesh);
-
-   chck_buffer_read_int(&mesh->id, sizeof(mesh->id), buffer); // ID?
-#if 0
-   {
-      union {
-         uint32_t tmp32;
-      };
-      chck_buffer_read_int(&tmp, sizeof(u.tmp32), buffer); // ID?
-      printf("1. %u\n", tmp);
-      chck_buffer_read_int(&tmp, sizeof(u.tmp32), buffer); // ID?
-      printf("2. %u\n", tmp);
-      chck_buffer_read_int(&tmp, sizeof(u.tmp32), buffer); // ID?
-      printf("3. %u\n", tmp);
-   }
-#else
-   chck_buffer_seek(buffer, 12, SEEK_CUR); // ???
-#endif
+enum extract_result {
+   EXTRACT_OK,
+   EXTRACT_SKIPPED,
+   EXTRACT_FAILED,
+};
 
-   // our IDs start from zero
-   mesh->id -= 1;
+struct extract_stats {
+   double input, parse, decode, encode, total; // seconds
+   uint64_t file_bytes, archive_bytes, out_bytes;
+   uint32_t unchanged, reused;
+   const char *io; // output backend, NULL if nothing was written
+   size_t arena_allocs, arena_blocks, arena_used, arena_reserved;
+};
 
-   uint32_t num_indices;
-   chck_buffer_read_int(&num_indices, sizeof(num_indices), buffer);
+struct chunk_histogram {
+   uint32_t type, count;
+   uint64_t bytes;
+};
 
-   uint32_t unknown;
-   chck_buffer_read_int(&unknown, sizeof(unknown), buffer);
-   if (unknown == 0x80000000)
-      return false;
+static double
+now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-   uint32_t unknownid;
-   chck_buffer_seek(buffer, 4, SEEK_CUR); // ???
-   chck_buffer_read_int(&unknownid, sizeof(unknownid), buffer); // Some ID?
-   chck_buffer_read_int(&mesh->mid, sizeof(mesh->mid), buffer); // Material ID?
+static int
+chunk_histogram_cmp(const void *a, const void *b)
+{
+   const struct chunk_histogram *ha = a, *hb = b;
+   return (ha->type < hb->type ? -1 : ha->type > hb->type);
+}
 
-   // our IDs start from zero
-   unknownid -= 1;
-   mesh->mid -= 1;
+static void
+stats_json(struct task_log *log, const struct ccs_data *data, const char *path, const struct extract_stats *stats, enum extract_result result)
+{
+   assert(log && data && path && stats);
+
+   static const char *results[] = { "ok", "skipped", "failed" };
+
+   task_log_printf(log, "{\"path\":");
+   json_string(log, path);
+   task_log_printf(log, ",\"name\":");
+   if (data->name)
+      json_string(log, data->name);
+   else
+      task_log_printf(log, "null");
+
+   task_log_printf(log, ",\"result\":\"%s\"", results[result]);
+   if (stats->io)
+      task_log_printf(log, ",\"io\":\"%s\"", stats->io);
+   task_log_printf(log, ",\"time\":{\"input\":%.6f,\"parse\":%.6f,\"decode\":%.6f,\"encode\":%.6f,\"total\":%.6f}",
+         stats->input, stats->parse, stats->decode, stats->encode, stats->total);
+   task_log_printf(log, ",\"bytes\":{\"file\":%llu,\"archive\":%llu,\"out\":%llu}",
+         (unsigned long long)stats->file_bytes, (unsigned long long)stats->archive_bytes, (unsigned long long)stats->out_bytes);
+
+   // every indexed chunk counts, decoded or not
+   task_log_printf(log, ",\"chunks\":{\"count\":%u,\"types\":[", data->num_chunks);
+   struct chunk_histogram *types = NULL;
+   uint32_t num_types = 0;
+   if (data->num_chunks && (types = calloc(data->num_chunks, sizeof(struct chunk_histogram)))) {
+      for (uint32_t i = 0; i < data->num_chunks; ++i) {
+         uint32_t t;
+         for (t = 0; t < num_types && types[t].type != data->chunks[i].type; ++t);
+         types[t].type = data->chunks[i].type;
+         types[t].count++;
+         types[t].bytes += data->chunks[i].size;
+         num_types += (t == num_types);
+      }
 
-   uint32_t num_vertices;
-   chck_buffer_read_int(&num_vertices, sizeof(num_vertices), buffer);
+      qsort(types, num_types, sizeof(struct chunk_histogram), chunk_histogram_cmp);
+   }
 
-   if (num_vertices > 100000) {
-      printf("VERTICES: %u\n", num_vertices);
-      return false;
+   for (uint32_t t = 0; t < num_types; ++t) {
+      task_log_printf(log, "%s{\"type\":\"0x%08x\",\"kind\":\"%s\",\"count\":%u,\"bytes\":%llu}",
+            (t ? "," : ""), types[t].type, ccs_chunk_type_name(types[t].type), types[t].count, (unsigned long long)types[t].bytes);
    }
+   free(types);
 
-   struct ccs_vec3f *vertices;
-   if (!num_vertices || !(vertices = calloc(num_vertices, sizeof(struct ccs_vec3f))))
-      return false;
+   task_log_printf(log, "]},\"decoded\":{\"meshes\":%u,\"images\":%u,\"unchanged\":%u,\"reused\":%u}", data->num_meshes, data->num_images, stats->unchanged, stats->reused);
 
-   for (uint32_t i = 0; i < num_vertices; ++i) {
-      int8_t data[6];
-      chck_buffer_read(data, sizeof(data), 1, buffer);
-      vertices[i].x = (float)(data[0] & 0xff) / 256.0f + (float)data[1];
-      vertices[i].y = (float)(data[2] & 0xff) / 256.0f + (float)data[3];
-      vertices[i].z = (float)(data[4] & 0xff) / 256.0f + (float)data[5];
+   // ru_maxrss is in kilobytes and covers the whole process so far
+   struct rusage usage;
+   memset(&usage, 0, sizeof(usage));
+   getrusage(RUSAGE_SELF, &usage);
+   task_log_printf(log, ",\"memory\":{\"arena_allocs\":%zu,\"arena_blocks\":%zu,\"arena_used\":%zu,\"arena_reserved\":%zu,\"peak_rss\":%llu}}\n",
+         stats->arena_allocs, stats->arena_blocks, stats->arena_used, stats->arena_reserved, (unsigned long long)usage.ru_maxrss * 1024);
+}
+
+static enum extract_result
+extract(struct ccs_data *data, const char *path, const char *dir, const struct export_options *options, uint32_t jobs, bool verbose, char *msg, size_t msg_size)
+{
+   assert(data && path && dir && options && msg);
+
+   struct extract_stats stats;
+   memset(&stats, 0, sizeof(stats));
+   const double start = now();
+
+   // map or decompress file
+   struct ccs_input input;
+   if (!ccs_input_open(&input, path)) {
+      snprintf(msg, msg_size, "cannot open file");
+      return EXTRACT_FAILED;
    }
 
-   chck_buffer_seek(buffer, (num_vertices * 6) % 4, SEEK_CUR); // normals / vcolors ?
+   stats.input = now() - start;
+   stats.archive_bytes = input.size;
+   stats.file_bytes = (options->stats ? file_size(path) : 0);
 
-   uint32_t *indices;
-   if (!num_vertices || !(indices = calloc(num_vertices, sizeof(uint32_t))))
-      return false;
+   struct chck_buffer buffer;
+   if (!chck_buffer_from_pointer(&buffer, input.data, input.size, CHCK_ENDIANESS_LITTLE)) {
+      snprintf(msg, msg_size, "not enough memory (%zu bytes)", input.size);
+      ccs_input_release(&input);
+      return EXTRACT_FAILED;
+   }
 
-   uint32_t num_triangles = 0;
-   for (uint32_t i = 0; i < num_vertices; ++i) {
-      chck_buffer_seek(buffer, 3, SEEK_CUR); // ???
-      uint8_t index;
-      chck_buffer_read_int(&index, sizeof(index), buffer); // ^ maybe int?
-      indices[i] = index;
-      num_triangles += (index == 0);
+   struct export_task *tasks = NULL;
+   uint32_t num_tasks = 0;
+
+   struct atlas atlas;
+   memset(&atlas, 0, sizeof(atlas));
+
+   struct manifest manifest;
+   memset(&manifest, 0, sizeof(manifest));
+   struct output *output = NULL;
+   uint64_t *hashes = NULL;
+   bool *skip = NULL;
+   char manifest_path[1024];
+   const bool incremental = (options->incremental && options->list == LIST_NONE);
+
+   enum extract_result ret = EXTRACT_FAILED;
+   double t = now();
+   if (!ccs_read_header(&buffer)) {
+      snprintf(msg, msg_size, "invalid header");
+      ret = EXTRACT_SKIPPED;
+      goto out;
    }
 
-   chck_buffer_seek(buffer, num_vertices * 4, SEEK_CUR); // normals / vcolors ?
+   if (!ccs_read_index(&buffer, data)) {
+      snprintf(msg, msg_size, "failed to read contents");
+      goto out;
+   }
 
-   struct ccs_vec2f *coords;
-   if (!num_vertices || !(coords = calloc(num_vertices, sizeof(struct ccs_vec2f))))
-      return false;
+   struct ccs_filter filter = options->filter;
+   if (incremental) {
+      // unchanged assets are never decoded, their outputs stay in place
+      snprintf(manifest_path, sizeof(manifest_path), "%s/guhck.manifest", dir);
+      if (!manifest_load(&manifest, manifest_path, options_hash(options)) ||
+          !(hashes = calloc(data->num_chunks + 1, sizeof(uint64_t))) ||
+          !(skip = calloc(data->num_chunks + 1, sizeof(bool))) ||
+          !plan_incremental(data, input.data, &manifest, dir, hashes, skip, &stats.unchanged)) {
+         snprintf(msg, msg_size, "not enough memory");
+         goto out;
+      }
 
-   for (uint32_t i = 0; i < num_vertices; ++i) {
-      int8_t data[4];
-      chck_buffer_read(data, sizeof(data), 1, buffer);
-      coords[i].x = (float)(data[0] & 0xff) / 256.0f + (float)data[1];
-      coords[i].y = (float)(data[2] & 0xff) / 256.0f + (float)data[3];
+      // atlases need every image, the manifest is only kept up to date
+      if (!options->atlas)
+         filter.skip = skip;
+      else
+         stats.unchanged = 0;
    }
 
-   mesh->num_triangles = num_triangles;
-   mesh->num_vertices = num_vertices;
-   mesh->indices = indices;
-   mesh->vertices = vertices;
-   mesh->coords = coords;
-   return true;
-}
+   stats.parse = now() - t;
+   t = now();
 
-static bool
-read_header(struct chck_buffer *buffer)
-{
-   assert(buffer);
-   uint32_t header = 0;
-   chck_buffer_read_int(&header, sizeof(header), buffer);
-   return (header == 0xcccc0001);
-}
+   const struct ccs_filter none = { 0 };
+   if (!ccs_read_chunks(&buffer, data, (options->list != LIST_NONE ? &none : &filter))) {
+      snprintf(msg, msg_size, "failed to read contents");
+      goto out;
+   }
 
-static bool
-read_contents(struct chck_buffer *buffer, struct ccs_data *data)
-{
-   assert(buffer && data);
+   stats.decode = now() - t;
 
-   chck_buffer_read_string_of_type((char **)&data->name, NULL, 4, buffer);
-   chck_buffer_seek(buffer, 23, SEEK_CUR); // useless waste
-   chck_buffer_seek(buffer, 24, SEEK_CUR); // ???
-   chck_buffer_read_int(&data->num_files, sizeof(data->num_files), buffer);
-   chck_buffer_read_int(&data->num_objects, sizeof(data->num_objects), buffer);
+   if (options->list != LIST_NONE) {
+      struct task_log log;
+      memset(&log, 0, sizeof(log));
+      if (options->list == LIST_JSON)
+         list_chunks_json(&log, data, path);
+      else
+         list_chunks_text(&log, data, path);
 
-   printf("%s (%zu)\n", data->name, strlen(data->name));
+      if (log.len)
+         fwrite(log.buf, 1, log.len, stdout);
 
-   // format counts from 1..9, we count from 0..9
-   data->num_files -= (data->num_files > 0);
-   data->num_objects -= (data->num_objects > 0);
+      snprintf(msg, msg_size, "%u chunks", data->num_chunks);
+      free(log.buf);
+      ret = EXTRACT_OK;
+      goto out;
+   }
 
-   if (data->num_files > 10000 || data->num_objects > 10000) {
-      printf("too many files: %u, %u\n", data->num_files, data->num_objects);
-      return false;
+   // tar members carry the directories in their names
+   if (!options->tar && !make_dirs(dir)) {
+      snprintf(msg, msg_size, "cannot create directory: %s", dir);
+      goto out;
    }
 
-   // read file names
-   chck_buffer_seek(buffer, 32, SEEK_CUR); // ???
-   if (data->num_files) {
-      char **strings;
-      if (!(strings = calloc(data->num_files, sizeof(char*))))
-         return false;
+   if (!(output = (options->tar ? output_new_tar(options->tar) : output_new(options->io)))) {
+      snprintf(msg, msg_size, (options->io == OUTPUT_URING ? "io_uring is not available" : "not enough memory"));
+      goto out;
+   }
 
-      if (!(data->files = (const char**)strings))
-         return false;
+   // workers queue finished files and go on encoding while they are written
+   struct export_options queued = *options;
+   queued.output = output;
+   stats.io = output_backend_name(output);
 
-      for (uint32_t i = 0; i < data->num_files; ++i) {
-         if (!(strings[i] = calloc(1, 33)))
-            return false;
+   uint32_t num_variants = 0;
+   for (uint32_t i = 0; options->all_palettes && i < data->num_images; ++i)
+      num_variants += data->images[i].num_palettes;
+
+   if (!(tasks = calloc(data->num_meshes + data->num_images + num_variants + 1, sizeof(struct export_task)))) {
+      snprintf(msg, msg_size, "not enough memory");
+      goto out;
+   }
 
-         chck_buffer_read(strings[i], 32, 1, buffer);
-         const uint32_t len = strlen(strings[i]);
-         if (len && len + 1 < 32 && !(strings[i] = realloc(strings[i], len + 1)))
-            return false;
+   uint32_t failed = 0;
+   for (uint32_t i = 0; i < data->num_meshes; ++i) {
+      const struct ccs_mesh *mesh = &data->meshes[i];
+      if (mesh->id >= data->num_objects || mesh->mid + 1 >= data->num_objects) {
+         ++failed;
+         continue;
       }
+
+      tasks[num_tasks++] = (struct export_task){ .type = EXPORT_MESH, .index = i, .name = data->objects[mesh->id] };
    }
 
-   // read object names
-   chck_buffer_seek(buffer, 32, SEEK_CUR); // ???
-   if (data->num_objects) {
-      char **strings;
-      if (!data->num_objects || !(strings = calloc(data->num_objects, sizeof(char*))))
-            return false;
+   const uint32_t first_image = num_tasks;
+   for (uint32_t i = 0; i < data->num_images; ++i) {
+      const struct ccs_image *image = &data->images[i];
+      if (image->id >= data->num_objects || !image->num_palettes) {
+         ++failed;
+         continue;
+      }
 
-      data->objects = (const char**)strings;
+      tasks[num_tasks++] = (struct export_task){ .type = EXPORT_IMAGE, .index = i, .name = data->objects[image->id] };
 
-      for (uint32_t i = 0; i < data->num_objects; ++i) {
-         if (!(strings[i] = calloc(1, 33)))
-            return false;
+      // palettes without an object have nothing to be named after
+      for (uint32_t p = 0; options->all_palettes && p < image->num_palettes; ++p) {
+         if (image->palettes[p].id < data->num_objects)
+            tasks[num_tasks++] = (struct export_task){ .type = EXPORT_IMAGE, .index = i, .palette = p, .name = data->objects[image->palettes[p].id], .variant = true };
+      }
+   }
+
+   if (!mark_overwritten(tasks, num_tasks)) {
+      snprintf(msg, msg_size, "not enough memory");
+      goto out;
+   }
 
-         chck_buffer_read(strings[i], 32, 1, buffer);
-         const uint32_t len = strlen(strings[i]);
-         if (len && len + 1 < 32 && !(strings[i] = realloc(strings[i], len + 1)))
-            return false;
+   // pages are written once every image has been blitted into them
+   const uint32_t first_atlas = num_tasks;
+   if (options->atlas) {
+      struct export_task *grown;
+      if (!atlas_build(&atlas, data, tasks, num_tasks, options->atlas) ||
+          !(grown = realloc(tasks, (num_tasks + atlas.num_pages + 1) * sizeof(struct export_task)))) {
+         snprintf(msg, msg_size, "not enough memory");
+         goto out;
       }
+
+      tasks = grown;
+      for (uint32_t p = 0; p < atlas.num_pages; ++p)
+         tasks[num_tasks++] = (struct export_task){ .type = EXPORT_ATLAS, .index = p, .name = "atlas" };
    }
 
-   // read data
-   {
-      uint32_t filetype = 0xcccc0005;
-#if 0
-      union {
-         uint8_t tmp8;
-      };
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("1: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("2: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("3: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("4: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("5: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("6: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("7: %u\n", tmp);
-      chck_buffer_read_int(&u.tmp8, sizeof(uint8_t), buffer);
-      printf("8: %u\n", tmp);
-#else
-      chck_buffer_seek(buffer, 8, SEEK_CUR); // ???
-#endif
+   struct export_stage stage = {
+      .data = data,
+      .options = &queued,
+      .dir = dir,
+      .tasks = tasks,
+      .atlas = (options->atlas ? &atlas : NULL),
+      .store_seed = (options->store ? options_hash(options) : 0),
+      .verbose = verbose,
+   };
+
+   t = now();
+   parallel_for(jobs, first_atlas, export_worker, &stage);
+   stage.tasks = tasks + first_atlas;
+   parallel_for(jobs, num_tasks - first_atlas, export_worker, &stage);
+
+   if (options->atlas) {
+      struct task_log log;
+      memset(&log, 0, sizeof(log));
+      atlas_json(&log, &atlas);
+
+      // handed to the output like the pages it describes
+      char buf[1024];
+      snprintf(buf, sizeof(buf), "%s/atlas.json", dir);
+      if (!output_write(output, buf, log.buf, log.len)) {
+         fprintf(stderr, "-!- %s: cannot write atlas description\n", buf);
+         ++failed;
+      }
+   }
 
-      uint32_t num_palettes = 0, mem_palettes = 2;
-      struct ccs_palette *palettes;
-      if (!(palettes = calloc(mem_palettes, sizeof(struct ccs_palette))))
-         return false;
+   // a file the output failed to write cannot be told apart from its task
+   uint32_t failed_writes;
+   output_flush(output, &stats.out_bytes, &failed_writes);
+   failed += failed_writes;
 
-      uint32_t num_images = 0, mem_images = 2;
-      struct ccs_image *images;
-      if (!(images = calloc(mem_images, sizeof(struct ccs_image))))
-         return false;
+   stats.encode = now() - t;
 
-      uint32_t num_meshes = 0, mem_meshes = 2;
-      struct ccs_mesh *meshes;
-      if (!(meshes = calloc(mem_meshes, sizeof(struct ccs_mesh))))
-         return false;
+   if (verbose) {
+      printf("  ____  _   _    ____ ____ ____    _______  _______ ____      _    ____ _____\n");
+      printf(" / ___|| | | |  / ___/ ___/ ___|  | ____\\ \\/ /_   _|  _ \\    / \\  / ___|_   _|\n");
+      printf("| |  _ | | | | | |  | |   \\___ \\  |  _|  \\  /  | | | |_) |  / _ \\| |     | |\n");
+      printf("| |_| || |_| | | |__| |___ ___) | | |___ /  \\  | | |  _ <  / ___ \\ |___  | |\n");
+      printf(" \\____(_)___/   \\____\\____|____/  |_____/_/\\_\\ |_| |_| \\_\\/_/   \\_\\____| |_|\n");
+      printf("\n%s (%s)\n", data->name, path);
 
-      while (1) {
-         chck_buffer_read_int(&filetype, sizeof(filetype), buffer);
-         if (filetype == 0x0 || filetype == 0xcccc0005 || filetype == 0xcccc1b00)
-            break;
-#if 0
-         printf("0x%x\n", filetype);
+#if 1
+      printf("\n--- FILES ---\n");
+      for (uint32_t i = 0; i < data->num_files; ++i)
+         printf("%u. %s\n", i, data->files[i]);
+      printf("\n--- OBJECTS ---\n");
+      for (uint32_t i = 0; i < data->num_objects; ++i)
+         printf("%u. %s\n", i, data->objects[i]);
 #endif
+      printf("\n--- MESHES ---\n");
+   }
 
-         uint32_t chunk_size = 0;
-         chck_buffer_read_int(&chunk_size, sizeof(chunk_size), buffer);
-         if (chunk_size * 4 > buffer->size - (buffer->curpos - buffer->buffer))
-            break;
+   // stdout belongs to the stats documents when they are on
+   for (uint32_t i = 0; i < num_tasks; ++i) {
+      if (verbose && i == first_image)
+         printf("\n--- IMAGES ---\n");
 
-         size_t start_offset = (buffer->curpos - buffer->buffer);
+      if (tasks[i].log.len)
+         fwrite(tasks[i].log.buf, 1, tasks[i].log.len, (options->stats ? stderr : stdout));
 
-#if 0
-         uint32_t id;
-         chck_buffer_read_int(&id, sizeof(id), buffer);
-         id -= (id > 0);
-         printf("0x%x (%u, %u)\n", filetype, id, chunk_size);
-         printf("%s\n", data->objects[id]);
-         chck_buffer_seek(buffer, start_offset, SEEK_SET);
-#endif
+      failed += tasks[i].failed;
+      stats.reused += tasks[i].reused;
+      stats.out_bytes += tasks[i].bytes;
+   }
 
-         size_t trail = 0;
-         switch (filetype) {
-            case 0xcccc2400: // BIN
-               // STRING
-               break;
-            case 0xcccc0100: // OBJECT
-            case 0Xcccc0a00:
-            case 0Xcccc2000:
-               break;
-            case 0xcccc0200: // MATERIAL
-               break;
-            case 0xcccc0700: // ANIMATION
-               break;
-            case 0xcccc0800: // MESH
-               if (read_mesh(buffer, &meshes[num_meshes])) {
-                  if (++num_meshes >= mem_meshes) {
-                     mem_meshes *= 2;
-                     if (!(meshes = realloc(meshes, mem_meshes * sizeof(struct ccs_mesh))))
-                        return false;
-                  }
-               }
-               break;
-            case 0xcccc0900: // CMP
-               break;
-            case 0xcccc0400: // PALETTE
-               if (!read_palette(buffer, &palettes[num_palettes], chunk_size * 4))
-                  return false;
-               if (++num_palettes >= mem_palettes) {
-                  mem_palettes *= 2;
-                  if (!(palettes = realloc(palettes, mem_palettes * sizeof(struct ccs_palette))))
-                     return false;
-               }
-               break;
-            case 0xcccc0300: // IMAGE
-               {
-                  trail = 200;
-                  if (!read_image(buffer, &images[num_images]))
-                     return false;
-
-                  if (!num_palettes) {
-                     free(palettes);
-                     palettes = NULL;
-                  } else if (num_palettes + 1 < mem_palettes) {
-                     palettes = realloc(palettes, (num_palettes + 1) * sizeof(struct ccs_palette));
-                  }
-
-                  images[num_images].num_palettes = num_palettes;
-                  images[num_images].palettes = palettes;
-
-                  if (++num_images >= mem_images) {
-                     mem_images *= 2;
-                     if (!(images = realloc(images, mem_images * sizeof(struct ccs_image))))
-                        return false;
-                  }
-
-                  num_palettes = 0;
-                  mem_palettes = 2;
-                  if (!(palettes = calloc(mem_palettes, sizeof(struct ccs_palette))))
-                     return false;
-               }
-               break;
-            default:break;
-         }
+   if (verbose && first_image == num_tasks)
+      printf("\n--- IMAGES ---\n");
 
-         chck_buffer_seek(buffer, start_offset, SEEK_SET);
-         chck_buffer_seek(buffer, chunk_size * 4 - trail, SEEK_CUR);
-      }
+   if (verbose)
+      printf("\nFILES: %u OBJECTS: %u\n", data->num_files, data->num_objects);
 
-      if (palettes)
-         free(palettes);
+   if (incremental) {
+      for (uint32_t i = 0; i < num_tasks; ++i) {
+         const struct export_task *task = &tasks[i];
+         if (task->overwritten || task->variant || task->type == EXPORT_ATLAS)
+            continue;
 
-      if (!num_images) {
-         free(images);
-         images = NULL;
-      } else if (num_images + 1 < mem_images) {
-         images = realloc(images, (num_images + 1) * sizeof(struct ccs_image));
+         const uint32_t kind = (task->type == EXPORT_MESH ? CCS_FILTER_MESH : CCS_FILTER_IMAGE);
+         const uint32_t chunk = (task->type == EXPORT_MESH ? data->meshes[task->index].chunk : data->images[task->index].chunk);
+         if (task->failed)
+            manifest_remove(&manifest, kind, task->name);
+         else if (!manifest_set(&manifest, kind, task->name, hashes[chunk]))
+            ++failed;
       }
 
-      data->num_images = num_images;
-      data->images = (const struct ccs_image*)images;
+      // keep the last manifest, whatever was rewritten is rewritten again next run
+      if (failed_writes)
+         fprintf(stderr, "-!- %s: not updated, %u files failed to write\n", manifest_path, failed_writes);
+      else if (!manifest_save(&manifest, manifest_path))
+         fprintf(stderr, "-!- %s: cannot write manifest\n", manifest_path);
+   }
 
-      if (!num_meshes) {
-         free(meshes);
-         meshes = NULL;
-      } else if (num_meshes + 1 < mem_meshes) {
-         meshes = realloc(meshes, (num_meshes + 1) * sizeof(struct ccs_mesh));
-      }
-      data->num_meshes = num_meshes;
-      data->meshes = (const struct ccs_mesh*)meshes;
+   snprintf(msg, msg_size, "%u meshes, %u images", data->num_meshes, data->num_images);
+   if (incremental)
+      snprintf(msg + strlen(msg), msg_size - strlen(msg), ", %u unchanged", stats.unchanged);
+   if (options->store)
+      snprintf(msg + strlen(msg), msg_size - strlen(msg), ", %u reused", stats.reused);
+   if (failed)
+      snprintf(msg + strlen(msg), msg_size - strlen(msg), ", %u failed to export", failed);
+
+   ret = EXTRACT_OK;
+
+out:
+   if (options->stats) {
+      stats.total = now() - start;
+      stats.arena_allocs = data->arena.num_allocs;
+      stats.arena_blocks = data->arena.num_blocks;
+      stats.arena_used = data->arena.used;
+      stats.arena_reserved = data->arena.reserved;
+
+      struct task_log log;
+      memset(&log, 0, sizeof(log));
+      stats_json(&log, data, path, &stats, ret);
+      if (log.len)
+         fwrite(log.buf, 1, log.len, stdout);
+      free(log.buf);
+   }
+
+   ccs_data_reset(data);
+   output_free(output);
+   atlas_release(&atlas);
+   manifest_release(&manifest);
+   free(hashes);
+   free(skip);
+   for (uint32_t i = 0; i < num_tasks; ++i)
+      free(tasks[i].log.buf);
+   free(tasks);
+   chck_buffer_release(&buffer);
+   ccs_input_release(&input);
+   return ret;
+}
+
+struct batch {
+   pthread_mutex_t mutex;
+   struct ccs_data *data; // one per worker, reused between archives
+   const struct export_options *options;
+   const char *output;
+   const char **paths;
+   uint32_t jobs;
+   uint32_t num_ok, num_skipped, num_failed;
+};
+
+static void
+batch_worker(uint32_t index, uint32_t worker, void *userdata)
+{
+   assert(userdata);
+   struct batch *batch = userdata;
+   const char *path = batch->paths[index];
+
+   char dir[1024], msg[256];
+   archive_dir(dir, sizeof(dir), batch->output, path);
+   const enum extract_result ret = extract(&batch->data[worker], path, dir, batch->options, batch->jobs, false, msg, sizeof(msg));
+
+   pthread_mutex_lock(&batch->mutex);
+   switch (ret) {
+      case EXTRACT_OK:
+         ++batch->num_ok;
+         if (batch->options->list == LIST_NONE && !batch->options->stats)
+            printf("-- %s: %s\n", path, msg);
+         break;
+      case EXTRACT_SKIPPED:
+         ++batch->num_skipped;
+         fprintf(stderr, "-!- %s: skipped, %s\n", path, msg);
+         break;
+      case EXTRACT_FAILED:
+         ++batch->num_failed;
+         fprintf(stderr, "-!- %s: %s\n", path, msg);
+         break;
+   }
+   pthread_mutex_unlock(&batch->mutex);
+}
+
+struct path_list {
+   char **paths;
+   uint32_t num_paths, mem_paths;
+};
+
+static bool
+path_list_add(struct path_list *list, const char *path)
+{
+   assert(list && path);
+
+   if (list->num_paths >= list->mem_paths) {
+      const uint32_t mem = (list->mem_paths ? list->mem_paths * 2 : 32);
+      char **paths;
+      if (!(paths = realloc(list->paths, mem * sizeof(char*))))
+         return false;
+
+      list->paths = paths;
+      list->mem_paths = mem;
    }
 
-   // trailing 12 bytes ???
+   if (!(list->paths[list->num_paths] = strdup(path)))
+      return false;
+
+   ++list->num_paths;
    return true;
 }
 
-int
-main(int argc, char **argv)
+static bool
+path_list_add_dir(struct path_list *list, const char *path)
 {
-   if (argc < 2) {
-      char *base;
-      if (!(base = strrchr(argv[0], '/')))
-         return EXIT_SUCCESS;
+   assert(list && path);
+
+   DIR *d;
+   if (!(d = opendir(path)))
+      return false;
+
+   struct dirent *e;
+   while ((e = readdir(d))) {
+      if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+         continue;
+
+      char buf[1024];
+      if (snprintf(buf, sizeof(buf), "%s/%s", path, e->d_name) >= (int)sizeof(buf))
+         continue;
 
-      if (base) base++; else base = argv[0];
-      fprintf(stderr, "usage: %s <file>\n", base);
-      return EXIT_SUCCESS;
+      struct stat st;
+      if (stat(buf, &st) != 0)
+         continue;
+
+      if (S_ISDIR(st.st_mode)) {
+         path_list_add_dir(list, buf);
+      } else if (S_ISREG(st.st_mode) && !path_list_add(list, buf)) {
+         closedir(d);
+         return false;
+      }
    }
 
-   // open and decompress file if needed
-   gzFile gf;
-   if (!(gf = gzopen(argv[1], "rb"))) {
-      fprintf(stderr, "cannot open file: %s\n", argv[1]);
-      return EXIT_FAILURE;
+   closedir(d);
+   return true;
+}
+
+static bool
+path_list_add_file(struct path_list *list, const char *path)
+{
+   assert(list && path);
+
+   FILE *f;
+   if (!(f = (!strcmp(path, "-") ? stdin : fopen(path, "r"))))
+      return false;
+
+   char line[1024];
+   while (fgets(line, sizeof(line), f)) {
+      line[strcspn(line, "\r\n")] = 0;
+      if (*line && !path_list_add(list, line))
+         break;
    }
 
-   size_t size = 4096000;
-   struct chck_buffer buffer;
-   if (!chck_buffer(&buffer, size, CHCK_ENDIANESS_LITTLE)) {
-      fprintf(stderr, "not enough memory (%ld bytes)\n", size);
-      return EXIT_FAILURE;
+   const bool ret = !ferror(f);
+   if (f != stdin)
+      fclose(f);
+   return ret;
+}
+
+static uint32_t
+parse_filter_kinds(const char *arg)
+{
+   assert(arg);
+
+   uint32_t kinds = 0;
+   for (const char *s = arg; *s;) {
+      const size_t len = strcspn(s, ",");
+      if (len == 4 && !strncmp(s, "mesh", len))
+         kinds |= CCS_FILTER_MESH;
+      else if (len == 5 && !strncmp(s, "image", len))
+         kinds |= CCS_FILTER_IMAGE;
+      else
+         return 0;
+      s += len + (s[len] == ',');
    }
 
-   // decompress/read
-   {
-      size_t read;
-      void *buf;
-      if (!(buf = malloc(size))) {
-         fprintf(stderr, "not enough memory (%ld bytes)\n", size);
-         return EXIT_FAILURE;
+   return kinds;
+}
+
+static int
+parse_png_filters(const char *arg)
+{
+   assert(arg);
+
+   static const struct {
+      const char *name;
+      int mask;
+   } filters[] = {
+      { "none", PNG_FILTER_NONE },
+      { "sub", PNG_FILTER_SUB },
+      { "up", PNG_FILTER_UP },
+      { "avg", PNG_FILTER_AVG },
+      { "paeth", PNG_FILTER_PAETH },
+      { "all", PNG_ALL_FILTERS },
+   };
+
+   int mask = 0;
+   for (const char *s = arg; *s;) {
+      const size_t len = strcspn(s, ",");
+
+      size_t i;
+      for (i = 0; i < sizeof(filters) / sizeof(filters[0]); ++i) {
+         if (strlen(filters[i].name) == len && !strncmp(filters[i].name, s, len))
+            break;
       }
 
-      while ((read = gzread(gf, buf, size)) != 0)
-         chck_buffer_write(buf, read, 1, &buffer);
-      free(buf);
+      if (i == sizeof(filters) / sizeof(filters[0]))
+         return -1;
+
+      mask |= filters[i].mask;
+      s += len + (s[len] == ',');
    }
 
-   chck_buffer_seek(&buffer, 0, SEEK_SET);
-   gzclose(gf);
+   return (mask ? mask : -1);
+}
+
+static void
+usage(const char *name)
+{
+   assert(name);
+
+   const char *base;
+   if ((base = strrchr(name, '/'))) base++; else base = name;
+   fprintf(stderr, "usage: %s [options] <file>\n", base);
+   fprintf(stderr, "       %s [options] <file|directory>...\n\n", base);
+   fprintf(stderr, "  -o, --output DIR   output directory (batch: one subdirectory per archive)\n");
+   fprintf(stderr, "      --tar FILE     stream every output into one tar FILE under the output directory, - for stdout\n");
+   fprintf(stderr, "  -f, --files FILE   read archive paths from FILE, - for stdin\n");
+   fprintf(stderr, "  -j, --jobs N       number of worker threads (default: number of cpus)\n");
+   fprintf(stderr, "      --list[=FMT]   list chunks without decoding them, FMT is text or json\n");
+   fprintf(stderr, "  -t, --type KINDS   only decode these kinds: mesh, image or a comma separated list\n");
+   fprintf(stderr, "      --object NAME  only decode chunks of object NAME, may be repeated\n");
+   fprintf(stderr, "      --png-level N  zlib compression level for PNG output, 0-9\n");
+   fprintf(stderr, "      --png-filter F PNG row filters: none, sub, up, avg, paeth, all or a comma separated list\n");
+   fprintf(stderr, "      --png-palette  write indexed PNGs that keep the image palette instead of RGBA\n");
+   fprintf(stderr, "      --all-palettes also write every palette of an image, named after the palette\n");
+   fprintf(stderr, "      --atlas[=SIZE] pack the images of each archive into SIZExSIZE atlases (default: 2048)\n");
+   fprintf(stderr, "      --store DIR    encode identical assets once into DIR and hard link them into the output\n");
+   fprintf(stderr, "      --io BACKEND   write outputs with io_uring, pwrite or auto (default: auto)\n");
+   fprintf(stderr, "      --incremental  only export assets whose chunks or options changed since the last run\n");
+   fprintf(stderr, "      --stats        print timings, chunk histogram and memory use of each archive as JSON\n");
+   fprintf(stderr, "  -v, --verbose      print parser debug output to stderr\n");
+   fprintf(stderr, "  -h, --help         show this help\n");
+}
 
-   if (!read_header(&buffer)) {
-      fprintf(stderr, "invalid header\n");
-      return EXIT_FAILURE;
+int
+main(int argc, char **argv)
+{
+   const char *output = ".", *tar = NULL;
+   long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+   struct path_list list;
+   memset(&list, 0, sizeof(list));
+   bool batch_mode = false;
+
+   struct export_options options = {
+      .png_level = -1,
+      .png_filters = -1,
+      .filter = { .kinds = CCS_FILTER_ALL },
+   };
+
+   enum {
+      OPT_PNG_LEVEL = 0x100,
+      OPT_PNG_FILTER,
+      OPT_PNG_PALETTE,
+      OPT_ALL_PALETTES,
+      OPT_LIST,
+      OPT_OBJECT,
+      OPT_STATS,
+      OPT_INCREMENTAL,
+      OPT_ATLAS,
+      OPT_STORE,
+      OPT_IO,
+      OPT_TAR,
+   };
+
+   static const struct option opts[] = {
+      { "output", required_argument, NULL, 'o' },
+      { "files", required_argument, NULL, 'f' },
+      { "jobs", required_argument, NULL, 'j' },
+      { "list", optional_argument, NULL, OPT_LIST },
+      { "type", required_argument, NULL, 't' },
+      { "object", required_argument, NULL, OPT_OBJECT },
+      { "stats", no_argument, NULL, OPT_STATS },
+      { "incremental", no_argument, NULL, OPT_INCREMENTAL },
+      { "atlas", optional_argument, NULL, OPT_ATLAS },
+      { "store", required_argument, NULL, OPT_STORE },
+      { "io", required_argument, NULL, OPT_IO },
+      { "tar", required_argument, NULL, OPT_TAR },
+      { "verbose", no_argument, NULL, 'v' },
+      { "png-level", required_argument, NULL, OPT_PNG_LEVEL },
+      { "png-filter", required_argument, NULL, OPT_PNG_FILTER },
+      { "png-palette", no_argument, NULL, OPT_PNG_PALETTE },
+      { "all-palettes", no_argument, NULL, OPT_ALL_PALETTES },
+      { "help", no_argument, NULL, 'h' },
+      { NULL, 0, NULL, 0 },
+   };
+
+   int c;
+   while ((c = getopt_long(argc, argv, "o:f:j:t:vh", opts, NULL)) != -1) {
+      switch (c) {
+         case 'o':
+            output = optarg;
+            break;
+         case 'f':
+            batch_mode = true;
+            if (!path_list_add_file(&list, optarg)) {
+               fprintf(stderr, "cannot read file list: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            break;
+         case 'j':
+            if ((jobs = strtol(optarg, NULL, 10)) < 1) {
+               fprintf(stderr, "invalid number of jobs: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            break;
+         case OPT_LIST:
+            if (!optarg || !strcmp(optarg, "text")) {
+               options.list = LIST_TEXT;
+            } else if (!strcmp(optarg, "json")) {
+               options.list = LIST_JSON;
+            } else {
+               fprintf(stderr, "invalid list format: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            break;
+         case 't':
+            if (!(options.filter.kinds = parse_filter_kinds(optarg))) {
+               fprintf(stderr, "invalid type: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            break;
+         case OPT_OBJECT:
+            {
+               const char **objects;
+               if (!(objects = realloc(options.filter.objects, (options.filter.num_objects + 1) * sizeof(char*)))) {
+                  fprintf(stderr, "not enough memory\n");
+                  return EXIT_FAILURE;
+               }
+               objects[options.filter.num_objects++] = optarg;
+               options.filter.objects = objects;
+            }
+            break;
+         case OPT_PNG_LEVEL:
+            {
+               char *end;
+               options.png_level = strtol(optarg, &end, 10);
+               if (*end || options.png_level < 0 || options.png_level > 9) {
+                  fprintf(stderr, "invalid png level: %s\n", optarg);
+                  return EXIT_FAILURE;
+               }
+            }
+            break;
+         case OPT_PNG_FILTER:
+            if ((options.png_filters = parse_png_filters(optarg)) < 0) {
+               fprintf(stderr, "invalid png filter: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            break;
+         case OPT_PNG_PALETTE:
+            options.png_palette = true;
+            break;
+         case OPT_ALL_PALETTES:
+            options.all_palettes = true;
+            break;
+         case OPT_STATS:
+            options.stats = true;
+            break;
+         case OPT_INCREMENTAL:
+            options.incremental = true;
+            break;
+         case OPT_STORE:
+            if (!make_dirs(optarg)) {
+               fprintf(stderr, "cannot create directory: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            options.store = optarg;
+            break;
+         case OPT_IO:
+            if (!strcmp(optarg, "auto")) {
+               options.io = OUTPUT_AUTO;
+            } else if (!strcmp(optarg, "io_uring")) {
+               options.io = OUTPUT_URING;
+            } else if (!strcmp(optarg, "pwrite")) {
+               options.io = OUTPUT_PWRITE;
+            } else {
+               fprintf(stderr, "invalid io backend: %s\n", optarg);
+               return EXIT_FAILURE;
+            }
+            break;
+         case OPT_TAR:
+            tar = optarg;
+            break;
+         case OPT_ATLAS:
+            {
+               char *end = NULL;
+               const long size = (optarg ? strtol(optarg, &end, 10) : 2048);
+               if ((end && *end) || size < 64 || size > 16384) {
+                  fprintf(stderr, "invalid atlas size: %s\n", optarg);
+                  return EXIT_FAILURE;
+               }
+               options.atlas = size;
+            }
+            break;
+         case 'v':
+            ++ccs_verbose;
+            break;
+         case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+         default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+      }
+   }
+
+   for (int i = optind; i < argc; ++i) {
+      struct stat st;
+      if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+         batch_mode = true;
+         if (!path_list_add_dir(&list, argv[i])) {
+            fprintf(stderr, "cannot read directory: %s\n", argv[i]);
+            return EXIT_FAILURE;
+         }
+      } else if (!path_list_add(&list, argv[i])) {
+         fprintf(stderr, "not enough memory\n");
+         return EXIT_FAILURE;
+      }
    }
 
-   struct ccs_data data;
-   memset(&data, 0, sizeof(data));
-   if (!read_contents(&buffer, &data)) {
-      fprintf(stderr, "failed to read contents\n");
-      return EXIT_FAILURE;
+   if (!list.num_paths) {
+      usage(argv[0]);
+      return (batch_mode ? EXIT_FAILURE : EXIT_SUCCESS);
    }
 
-   printf("  ____  _   _    ____ ____ ____    _______  _______ ____      _    ____ _____\n");
-   printf(" / ___|| | | |  / ___/ ___/ ___|  | ____\\ \\/ /_   _|  _ \\    / \\  / ___|_   _|\n");
-   printf("| |  _ | | | | | |  | |   \\___ \\  |  _|  \\  /  | | | |_) |  / _ \\| |     | |\n");
-   printf("| |_| || |_| | | |__| |___ ___) | | |___ /  \\  | | |  _ <  / ___ \\ |___  | |\n");
-   printf(" \\____(_)___/   \\____\\____|____/  |_____/_/\\_\\ |_| |_| \\_\\/_/   \\_\\____| |_|\n");
-   printf("\n%s (%s)\n", data.name, argv[1]);
+   if (jobs < 1)
+      jobs = 1;
 
-#if 1
-   printf("\n--- FILES ---\n");
-   for (uint32_t i = 0; i < data.num_files; ++i)
-      printf("%u. %s\n", i, data.files[i]);
-   printf("\n--- OBJECTS ---\n");
-   for (uint32_t i = 0; i < data.num_objects; ++i)
-      printf("%u. %s\n", i, data.objects[i]);
-#endif
-   printf("\n--- MESHES ---\n");
-   for (uint32_t i = 0; i < data.num_meshes; ++i) {
-      printf("• %s\n", data.objects[data.meshes[i].id]);
-      printf("    • %s\n", data.objects[data.meshes[i].mid]);
-
-      char buf[256];
-      snprintf(buf, sizeof(buf) - 1, "%s.obj", data.objects[data.meshes[i].id]);
-      char buf2[256];
-      snprintf(buf2, sizeof(buf2) - 1, "%s.png", data.objects[data.meshes[i].mid + 1]);
-      write_mesh(&data.meshes[i], buf2, data.objects[data.meshes[i].id], buf);
-   }
-
-   printf("\n--- IMAGES ---\n");
-   for (uint32_t i = 0; i < data.num_images; ++i) {
-      printf("• %s (%ux%u)\n", data.objects[data.images[i].id], data.images[i].width, data.images[i].height);
-      for (uint32_t p = 0; p < data.images[i].num_palettes; ++p) {
-         printf("    • %s palette with num colors %u\n",
-               data.objects[data.images[i].palettes[p].id],
-               data.images[i].palettes[p].num_colors);
+   if (tar) {
+      // both need the outputs on disk to link or compare against
+      if (options.store || options.incremental) {
+         fprintf(stderr, "--tar cannot be combined with %s\n", (options.store ? "--store" : "--incremental"));
+         return EXIT_FAILURE;
+      }
+
+      int fd;
+      if (!strcmp(tar, "-")) {
+         if (isatty(STDOUT_FILENO)) {
+            fprintf(stderr, "refusing to write tar to a terminal\n");
+            return EXIT_FAILURE;
+         }
+
+         // the stream owns stdout, everything printed goes to stderr instead
+         if ((fd = dup(STDOUT_FILENO)) < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            fprintf(stderr, "cannot write tar to stdout\n");
+            return EXIT_FAILURE;
+         }
+      } else if ((fd = open(tar, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+         fprintf(stderr, "cannot open tar: %s\n", tar);
+         return EXIT_FAILURE;
       }
 
-      char buf[256];
-      snprintf(buf, sizeof(buf) - 1, "%s.png", data.objects[data.images[i].id]);
-      write_image(&data.images[i], 0, buf);
+      if (!(options.tar = tar_open(fd))) {
+         fprintf(stderr, "not enough memory\n");
+         close(fd);
+         return EXIT_FAILURE;
+      }
+   }
+
+   int ret = EXIT_SUCCESS;
+   if (!batch_mode && list.num_paths == 1) {
+      char msg[256];
+      struct ccs_data data;
+      memset(&data, 0, sizeof(data));
+      if (extract(&data, list.paths[0], output, &options, jobs, !options.stats, msg, sizeof(msg)) != EXTRACT_OK) {
+         fprintf(stderr, "%s\n", msg);
+         ret = EXIT_FAILURE;
+      }
+      ccs_data_release(&data);
+   } else {
+      // split threads between archives and their export stages
+      const uint32_t workers = ((uint32_t)jobs > list.num_paths ? list.num_paths : (uint32_t)jobs);
+
+      struct batch batch;
+      memset(&batch, 0, sizeof(batch));
+      batch.options = &options;
+      batch.output = output;
+      batch.paths = (const char**)list.paths;
+      batch.jobs = jobs / workers;
+
+      if (!(batch.data = calloc(workers, sizeof(struct ccs_data)))) {
+         fprintf(stderr, "not enough memory\n");
+         return EXIT_FAILURE;
+      }
+
+      pthread_mutex_init(&batch.mutex, NULL);
+      parallel_for(workers, list.num_paths, batch_worker, &batch);
+
+      for (uint32_t i = 0; i < workers; ++i)
+         ccs_data_release(&batch.data[i]);
+      free(batch.data);
+
+      if (options.list == LIST_NONE && !options.stats)
+         printf("\n%u extracted, %u skipped, %u failed\n", batch.num_ok, batch.num_skipped, batch.num_failed);
+      ret = (batch.num_failed ? EXIT_FAILURE : EXIT_SUCCESS);
+      pthread_mutex_destroy(&batch.mutex);
+   }
+
+   if (options.tar && !tar_close(options.tar)) {
+      fprintf(stderr, "cannot write tar: %s\n", tar);
+      ret = EXIT_FAILURE;
    }
 
-   printf("\nFILES: %u OBJECTS: %u\n", data.num_files, data.num_objects);
-   return EXIT_SUCCESS;
+   for (uint32_t i = 0; i < list.num_paths; ++i)
+      free(list.paths[i]);
+   free(list.paths);
+   free(options.filter.objects);
+   return ret;
 }
 
 /* vim: set ts=8 sw=3 tw=0 :*/
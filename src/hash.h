@@ -0,0 +1,15 @@
+#ifndef __guhck_hash__
+#define __guhck_hash__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * XXH64 of len bytes.
+ * Chain calls through seed to hash several buffers as one.
+ */
+uint64_t hash64(const void *data, size_t len, uint64_t seed);
+
+#endif /* __guhck_hash__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,378 @@
+#include "kernels.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  define KERNELS_X86 1
+#  include <immintrin.h>
+#endif
+
+struct palette_lut {
+   uint32_t rgba[256]; // RGBA quads, zero past num_colors
+   uint8_t planes[4][16]; // R, G, B and A of the first 16 colors
+   uint32_t num_colors;
+};
+
+typedef size_t (*expand_row_fn)(uint8_t *dst, const uint8_t *src, uint32_t width, const struct palette_lut *lut);
+
+static size_t
+expand_row8_scalar(uint8_t *dst, const uint8_t *src, uint32_t width, const struct palette_lut *lut)
+{
+   size_t bad = 0;
+   for (uint32_t x = 0; x < width; ++x) {
+      memcpy(dst + x * 4, &lut->rgba[src[x]], 4);
+      bad += (src[x] >= lut->num_colors);
+   }
+   return bad;
+}
+
+static size_t
+expand_row4_scalar(uint8_t *dst, const uint8_t *src, uint32_t width, const struct palette_lut *lut)
+{
+   size_t bad = 0;
+   for (uint32_t x = 0; x < width; ++x) {
+      const uint8_t index = (x & 1 ? src[x / 2] >> 4 : src[x / 2] & 0x0f);
+      memcpy(dst + x * 4, &lut->rgba[index], 4);
+      bad += (index >= lut->num_colors);
+   }
+   return bad;
+}
+
+#if KERNELS_X86
+
+__attribute__((target("ssse3"))) static inline size_t
+expand16_ssse3(uint8_t *dst, __m128i index, const struct palette_lut *lut)
+{
+   // indices past the palette get their high bit set, pshufb yields zero for those
+   const __m128i n = _mm_set1_epi8((char)lut->num_colors);
+   const __m128i bad = _mm_cmpeq_epi8(_mm_max_epu8(index, n), index);
+   index = _mm_or_si128(index, bad);
+
+   const __m128i r = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)lut->planes[0]), index);
+   const __m128i g = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)lut->planes[1]), index);
+   const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)lut->planes[2]), index);
+   const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)lut->planes[3]), index);
+
+   const __m128i rg_lo = _mm_unpacklo_epi8(r, g), rg_hi = _mm_unpackhi_epi8(r, g);
+   const __m128i ba_lo = _mm_unpacklo_epi8(b, a), ba_hi = _mm_unpackhi_epi8(b, a);
+   _mm_storeu_si128((__m128i*)dst + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+   _mm_storeu_si128((__m128i*)dst + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+   _mm_storeu_si128((__m128i*)dst + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+   _mm_storeu_si128((__m128i*)dst + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+   return __builtin_popcount(_mm_movemask_epi8(bad));
+}
+
+// palettes of at most 16 colors, the usual case for 4bpp images
+__attribute__((target("ssse3"))) static size_t
+expand_row8_ssse3(uint8_t *dst, const uint8_t *src, uint32_t width, const struct palette_lut *lut)
+{
+   size_t bad = 0;
+   uint32_t x = 0;
+   for (; x + 16 <= width; x += 16)
+      bad += expand16_ssse3(dst + x * 4, _mm_loadu_si128((const __m128i*)(src + x)), lut);
+   return bad + expand_row8_scalar(dst + x * 4, src + x, width - x, lut);
+}
+
+__attribute__((target("ssse3"))) static size_t
+expand_row4_ssse3(uint8_t *dst, const uint8_t *src, uint32_t width, const struct palette_lut *lut)
+{
+   const __m128i mask = _mm_set1_epi8(0x0f);
+
+   size_t bad = 0;
+   uint32_t x = 0;
+   for (; x + 16 <= width; x += 16) {
+      const __m128i packed = _mm_loadl_epi64((const __m128i*)(src + x / 2));
+      const __m128i lo = _mm_and_si128(packed, mask);
+      const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+      bad += expand16_ssse3(dst + x * 4, _mm_unpacklo_epi8(lo, hi), lut);
+   }
+   return bad + expand_row4_scalar(dst + x * 4, src + x / 2, width - x, lut);
+}
+
+__attribute__((target("avx2"))) static size_t
+expand_row8_avx2(uint8_t *dst, const uint8_t *src, uint32_t width, const struct palette_lut *lut)
+{
+   const __m256i last = _mm256_set1_epi32((int)lut->num_colors - 1);
+
+   size_t bad = 0;
+   uint32_t x = 0;
+   for (; x + 8 <= width; x += 8) {
+      const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x)));
+      _mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_i32gather_epi32((const int*)lut->rgba, index, 4));
+      bad += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(index, last))));
+   }
+   return bad + expand_row8_scalar(dst + x * 4, src + x, width - x, lut);
+}
+
+#endif /* KERNELS_X86 */
+
+static expand_row_fn
+select_expand_row(uint32_t bpp, uint32_t num_colors)
+{
+#if KERNELS_X86
+   if (num_colors <= 16 && __builtin_cpu_supports("ssse3"))
+      return (bpp == 4 ? expand_row4_ssse3 : expand_row8_ssse3);
+   if (bpp == 8 && __builtin_cpu_supports("avx2"))
+      return expand_row8_avx2;
+#else
+   (void)num_colors;
+#endif
+   return (bpp == 4 ? expand_row4_scalar : expand_row8_scalar);
+}
+
+size_t
+kernel_expand_rgba_flipped(uint8_t *dst, const uint8_t *indices, uint32_t bpp, uint32_t width, uint32_t height, const uint8_t *colors, uint32_t num_colors)
+{
+   assert(dst && indices && (colors || !num_colors) && (bpp == 4 || bpp == 8));
+
+   struct palette_lut lut;
+   memset(&lut, 0, sizeof(lut));
+   lut.num_colors = (num_colors > 256 ? 256 : num_colors);
+   memcpy(lut.rgba, colors, lut.num_colors * 4);
+
+   for (uint32_t i = 0; i < 16 && i < lut.num_colors; ++i) {
+      for (uint32_t c = 0; c < 4; ++c)
+         lut.planes[c][i] = colors[i * 4 + c];
+   }
+
+   size_t bad = 0;
+   const size_t stride = (size_t)width * 4;
+
+   // 4bpp rows of odd width don't start on a byte boundary,
+   // palettes bigger than the nibble LUT want the 8bpp kernels
+   if (bpp == 4 && ((width & 1) || (select_expand_row(4, lut.num_colors) == expand_row4_scalar &&
+                                    select_expand_row(8, lut.num_colors) != expand_row8_scalar))) {
+      const size_t count = (size_t)width * height;
+      uint8_t *unpacked;
+      if ((unpacked = malloc(count))) {
+         kernel_unpack_nibbles(unpacked, indices, count);
+         bad = kernel_expand_rgba_flipped(dst, unpacked, 8, width, height, colors, num_colors);
+         free(unpacked);
+         return bad;
+      }
+
+      // out of memory, only even widths can take the row kernel
+      if (width & 1) {
+         for (uint32_t y = 0; y < height; ++y) {
+            uint8_t *row = dst + (height - 1 - y) * stride;
+            for (uint32_t x = 0; x < width; ++x) {
+               const size_t i = (size_t)y * width + x;
+               const uint8_t index = (i & 1 ? indices[i / 2] >> 4 : indices[i / 2] & 0x0f);
+               memcpy(row + x * 4, &lut.rgba[index], 4);
+               bad += (index >= lut.num_colors);
+            }
+         }
+         return bad;
+      }
+   }
+
+   const expand_row_fn expand_row = select_expand_row(bpp, lut.num_colors);
+   const size_t src_stride = (bpp == 4 ? width / 2 : width);
+   for (uint32_t y = 0; y < height; ++y)
+      bad += expand_row(dst + (height - 1 - y) * stride, indices + y * src_stride, width, &lut);
+
+   return bad;
+}
+
+static void
+fixed88_scalar(float *dst, const uint8_t *src, size_t count)
+{
+   for (size_t i = 0; i < count; ++i)
+      dst[i] = (float)(int16_t)(src[i * 2] | src[i * 2 + 1] << 8) * (1.0f / 256.0f);
+}
+
+#if KERNELS_X86
+
+__attribute__((target("avx2"))) static void
+fixed88_avx2(float *dst, const uint8_t *src, size_t count)
+{
+   const __m256 scale = _mm256_set1_ps(1.0f / 256.0f);
+
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16) {
+      const __m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 2));
+      const __m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 2 + 16));
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(lo)), scale));
+      _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(hi)), scale));
+   }
+
+   fixed88_scalar(dst + i, src + i * 2, count - i);
+}
+
+// SSE2 is baseline on x86-64, the target attribute only matters for 32 bit builds
+__attribute__((target("sse2"))) static void
+fixed88_sse2(float *dst, const uint8_t *src, size_t count)
+{
+   const __m128 scale = _mm_set1_ps(1.0f / 256.0f);
+
+   size_t i = 0;
+   for (; i + 8 <= count; i += 8) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2));
+      // sign extend by unpacking into the high half and shifting back down
+      const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+      _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+   }
+
+   fixed88_scalar(dst + i, src + i * 2, count - i);
+}
+
+__attribute__((target("sse2"))) static uint32_t
+strip_flags_sse2(uint32_t *dst, const uint8_t *src, uint32_t count)
+{
+   const __m128i zero = _mm_setzero_si128();
+
+   uint32_t zeros = 0, i = 0;
+   for (; i + 4 <= count; i += 4) {
+      const __m128i flags = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(src + i * 4)), 24);
+      _mm_storeu_si128((__m128i*)(dst + i), flags);
+      zeros += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(flags, zero))));
+   }
+
+   for (; i < count; ++i)
+      zeros += ((dst[i] = src[i * 4 + 3]) == 0);
+
+   return zeros;
+}
+
+#endif /* KERNELS_X86 */
+
+void
+kernel_fixed88_to_float(float *dst, const uint8_t *src, size_t count)
+{
+   assert((dst && src) || !count);
+
+#if KERNELS_X86
+   if (__builtin_cpu_supports("avx2"))
+      fixed88_avx2(dst, src, count);
+   else if (__builtin_cpu_supports("sse2"))
+      fixed88_sse2(dst, src, count);
+   else
+#endif
+      fixed88_scalar(dst, src, count);
+}
+
+uint32_t
+kernel_strip_flags(uint32_t *dst, const uint8_t *src, uint32_t count)
+{
+   assert((dst && src) || !count);
+
+#if KERNELS_X86
+   if (__builtin_cpu_supports("sse2"))
+      return strip_flags_sse2(dst, src, count);
+#endif
+
+   uint32_t zeros = 0;
+   for (uint32_t i = 0; i < count; ++i)
+      zeros += ((dst[i] = src[i * 4 + 3]) == 0);
+   return zeros;
+}
+
+#define ALPHA(a) (uint8_t)((a) <= 128 ? (a) * 255 / 128 : (a))
+#define ALPHA4(a) ALPHA(a), ALPHA(a + 1), ALPHA(a + 2), ALPHA(a + 3)
+#define ALPHA16(a) ALPHA4(a), ALPHA4(a + 4), ALPHA4(a + 8), ALPHA4(a + 12)
+#define ALPHA64(a) ALPHA16(a), ALPHA16(a + 16), ALPHA16(a + 32), ALPHA16(a + 48)
+static const uint8_t alpha_lut[256] = { ALPHA64(0), ALPHA64(64), ALPHA64(128), ALPHA64(192) };
+#undef ALPHA64
+#undef ALPHA16
+#undef ALPHA4
+#undef ALPHA
+
+static void
+expand_alpha_scalar(uint8_t *rgba, size_t count)
+{
+   for (size_t i = 0; i < count; ++i)
+      rgba[i * 4 + 3] = alpha_lut[rgba[i * 4 + 3]];
+}
+
+#if KERNELS_X86
+
+__attribute__((target("sse2"))) static void
+expand_alpha_sse2(uint8_t *rgba, size_t count)
+{
+   const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+   const __m128i half = _mm_set1_epi32(128);
+   const __m128i full = _mm_set1_epi32(255);
+
+   size_t i = 0;
+   for (; i + 4 <= count; i += 4) {
+      const __m128i x = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+      const __m128i a = _mm_srli_epi32(x, 24);
+      // a * 255 fits in the low 16 bits of each lane, the high halves stay zero
+      const __m128i scaled = _mm_srli_epi32(_mm_mullo_epi16(a, full), 7);
+      const __m128i keep = _mm_cmpgt_epi32(a, half);
+      const __m128i na = _mm_or_si128(_mm_and_si128(keep, a), _mm_andnot_si128(keep, scaled));
+      _mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_or_si128(_mm_and_si128(x, rgb), _mm_slli_epi32(na, 24)));
+   }
+
+   expand_alpha_scalar(rgba + i * 4, count - i);
+}
+
+#endif /* KERNELS_X86 */
+
+void
+kernel_expand_alpha(uint8_t *rgba, size_t count)
+{
+   assert(rgba || !count);
+
+#if KERNELS_X86
+   if (__builtin_cpu_supports("sse2")) {
+      expand_alpha_sse2(rgba, count);
+      return;
+   }
+#endif
+
+   expand_alpha_scalar(rgba, count);
+}
+
+static void
+unpack_nibbles_scalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+   for (size_t i = 0; i + 1 < count; i += 2) {
+      dst[i] = src[i / 2] & 0x0f;
+      dst[i + 1] = src[i / 2] >> 4;
+   }
+
+   if (count & 1)
+      dst[count - 1] = src[count / 2] & 0x0f;
+}
+
+#if KERNELS_X86
+
+__attribute__((target("sse2"))) static void
+unpack_nibbles_sse2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+   const __m128i mask = _mm_set1_epi8(0x0f);
+
+   size_t i = 0;
+   for (; i + 32 <= count; i += 32) {
+      const __m128i packed = _mm_loadu_si128((const __m128i*)(src + i / 2));
+      const __m128i lo = _mm_and_si128(packed, mask);
+      const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(lo, hi));
+      _mm_storeu_si128((__m128i*)(dst + i + 16), _mm_unpackhi_epi8(lo, hi));
+   }
+
+   unpack_nibbles_scalar(dst + i, src + i / 2, count - i);
+}
+
+#endif /* KERNELS_X86 */
+
+void
+kernel_unpack_nibbles(uint8_t *dst, const uint8_t *src, size_t count)
+{
+   assert((dst && src) || !count);
+
+#if KERNELS_X86
+   if (__builtin_cpu_supports("sse2")) {
+      unpack_nibbles_sse2(dst, src, count);
+      return;
+   }
+#endif
+
+   unpack_nibbles_scalar(dst, src, count);
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
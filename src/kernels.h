@@ -0,0 +1,39 @@
+#ifndef __guhck_kernels__
+#define __guhck_kernels__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Expand palette indices to RGBA, writing the rows bottom-up.
+ * indices are 8bpp, or 4bpp packed low nibble first.
+ * colors holds num_colors RGBA quads.
+ * Indices outside the palette become transparent black, returns their count.
+ */
+size_t kernel_expand_rgba_flipped(uint8_t *dst, const uint8_t *indices, uint32_t bpp, uint32_t width, uint32_t height, const uint8_t *colors, uint32_t num_colors);
+
+/**
+ * Decode count little-endian 8.8 fixed point values (low byte fraction,
+ * high byte signed integer part) into floats.
+ */
+void kernel_fixed88_to_float(float *dst, const uint8_t *src, size_t count);
+
+/**
+ * Extract the strip flag, the last byte of each 4 byte vertex record.
+ * Returns the number of zero flags.
+ */
+uint32_t kernel_strip_flags(uint32_t *dst, const uint8_t *src, uint32_t count);
+
+/**
+ * Rescale alpha of count RGBA quads in place, a <= 128 ? a * 255 / 128 : a.
+ */
+void kernel_expand_alpha(uint8_t *rgba, size_t count);
+
+/**
+ * Unpack count 4bpp indices, low nibble first, to one index per byte.
+ */
+void kernel_unpack_nibbles(uint8_t *dst, const uint8_t *src, size_t count);
+
+#endif /* __guhck_kernels__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
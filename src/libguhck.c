@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <chck/buffer/buffer.h>
+#include <guhck.h>
+#include "ccs.h"
+#include "kernels.h"
+#include "mesh.h"
+
+struct guhck_archive {
+   struct ccs_input input;
+   struct chck_buffer buffer;
+   struct ccs_data data;
+   bool decoded; // payloads are in data, index has to be re-read to decode again
+};
+
+static const char*
+object_name(const struct ccs_data *data, uint32_t id)
+{
+   assert(data);
+   return (id < data->num_objects ? data->objects[id] : NULL);
+}
+
+static struct guhck_archive*
+archive_new(struct ccs_input *input)
+{
+   assert(input);
+
+   struct guhck_archive *archive;
+   if (!(archive = calloc(1, sizeof(struct guhck_archive)))) {
+      ccs_input_release(input);
+      return NULL;
+   }
+
+   archive->input = *input;
+   if (!chck_buffer_from_pointer(&archive->buffer, archive->input.data, archive->input.size, CHCK_ENDIANESS_LITTLE)) {
+      ccs_input_release(&archive->input);
+      free(archive);
+      return NULL;
+   }
+
+   if (!ccs_read_header(&archive->buffer) || !ccs_read_index(&archive->buffer, &archive->data)) {
+      guhck_archive_close(archive);
+      return NULL;
+   }
+
+   return archive;
+}
+
+struct guhck_archive*
+guhck_archive_open_memory(const void *data, size_t size)
+{
+   struct ccs_input input;
+   if (!data || !ccs_input_from_memory(&input, data, size))
+      return NULL;
+
+   return archive_new(&input);
+}
+
+struct guhck_archive*
+guhck_archive_open(const char *path)
+{
+   struct ccs_input input;
+   if (!path || !ccs_input_open(&input, path))
+      return NULL;
+
+   return archive_new(&input);
+}
+
+void
+guhck_archive_close(struct guhck_archive *archive)
+{
+   if (!archive)
+      return;
+
+   ccs_data_release(&archive->data);
+   chck_buffer_release(&archive->buffer);
+   ccs_input_release(&archive->input);
+   free(archive);
+}
+
+const char*
+guhck_archive_name(const struct guhck_archive *archive)
+{
+   assert(archive);
+   return archive->data.name;
+}
+
+static bool
+deliver_meshes(const struct ccs_data *data, const struct guhck_callbacks *callbacks, bool *stop)
+{
+   assert(data && callbacks && stop);
+
+   for (uint32_t i = 0; i < data->num_meshes && !*stop; ++i) {
+      const struct ccs_mesh *mesh = &data->meshes[i];
+
+      struct ccs_geometry geometry;
+      if (!ccs_mesh_decode(mesh, &geometry))
+         return false;
+
+      struct trimesh tri;
+      const bool built = trimesh_from_strips(&tri, &geometry.vertices[0].x, &geometry.coords[0].x, geometry.indices, geometry.num_vertices);
+      ccs_geometry_release(&geometry);
+
+      if (!built || !trimesh_optimize(&tri)) {
+         trimesh_release(&tri);
+         return false;
+      }
+
+      const struct guhck_mesh out = {
+         .name = object_name(data, mesh->id),
+         .material = object_name(data, mesh->mid),
+         .texture = object_name(data, mesh->mid + 1),
+         .num_vertices = tri.num_vertices,
+         .num_triangles = tri.num_triangles,
+         .positions = tri.positions,
+         .coords = tri.coords,
+         .indices = tri.indices,
+      };
+
+      *stop = !callbacks->mesh(&out, callbacks->userdata);
+      trimesh_release(&tri);
+   }
+
+   return true;
+}
+
+static bool
+deliver_images(const struct ccs_data *data, const struct guhck_callbacks *callbacks, bool *stop)
+{
+   assert(data && callbacks && stop);
+
+   struct guhck_palette *palettes = NULL;
+   uint32_t mem_palettes = 0;
+
+   for (uint32_t i = 0; i < data->num_images && !*stop; ++i) {
+      const struct ccs_image *image = &data->images[i];
+
+      if (image->num_palettes > mem_palettes) {
+         struct guhck_palette *tmp;
+         if (!(tmp = realloc(palettes, image->num_palettes * sizeof(struct guhck_palette)))) {
+            free(palettes);
+            return false;
+         }
+
+         palettes = tmp;
+         mem_palettes = image->num_palettes;
+      }
+
+      for (uint32_t p = 0; p < image->num_palettes; ++p) {
+         palettes[p] = (struct guhck_palette){
+            .name = object_name(data, image->palettes[p].id),
+            .num_colors = image->palettes[p].num_colors,
+            .colors = (const uint8_t*)image->palettes[p].colors,
+         };
+      }
+
+      const struct guhck_image out = {
+         .name = object_name(data, image->id),
+         .width = image->width,
+         .height = image->height,
+         .bpp = image->bpp,
+         .indices = image->indices,
+         .num_palettes = image->num_palettes,
+         .palettes = (image->num_palettes ? palettes : NULL),
+      };
+
+      *stop = !callbacks->image(&out, callbacks->userdata);
+   }
+
+   free(palettes);
+   return true;
+}
+
+bool
+guhck_archive_decode(struct guhck_archive *archive, const struct guhck_callbacks *callbacks)
+{
+   assert(archive && callbacks);
+
+   // decoded payloads stay in the arena until the archive is decoded again
+   if (archive->decoded) {
+      ccs_data_reset(&archive->data);
+      archive->decoded = false;
+      chck_buffer_seek(&archive->buffer, 0, SEEK_SET);
+      if (!ccs_read_header(&archive->buffer) || !ccs_read_index(&archive->buffer, &archive->data))
+         return false;
+   }
+
+   const struct ccs_filter filter = {
+      .kinds = (callbacks->mesh ? CCS_FILTER_MESH : 0) | (callbacks->image ? CCS_FILTER_IMAGE : 0),
+   };
+
+   if (!filter.kinds)
+      return true;
+
+   archive->decoded = true;
+   if (!ccs_read_chunks(&archive->buffer, &archive->data, &filter))
+      return false;
+
+   bool stop = false;
+   if (callbacks->mesh && !deliver_meshes(&archive->data, callbacks, &stop))
+      return false;
+
+   if (callbacks->image && !deliver_images(&archive->data, callbacks, &stop))
+      return false;
+
+   return true;
+}
+
+bool
+guhck_image_rgba(const struct guhck_image *image, uint32_t palette, uint8_t *rgba)
+{
+   assert(image && rgba);
+
+   if (palette >= image->num_palettes || (image->bpp != 4 && image->bpp != 8))
+      return false;
+
+   const struct guhck_palette *p = &image->palettes[palette];
+   kernel_expand_rgba_flipped(rgba, image->indices, image->bpp, image->width, image->height, p->colors, p->num_colors);
+   return true;
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200809L
+#include "manifest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+// one line per asset: hash kind name
+#define MANIFEST_MAGIC "guhck-manifest 1"
+
+static int
+entry_cmp(uint32_t kind, const char *name, const struct manifest_entry *entry)
+{
+   assert(name && entry);
+   if (kind != entry->kind)
+      return (kind < entry->kind ? -1 : 1);
+   return strcmp(name, entry->name);
+}
+
+static uint32_t
+lower_bound(const struct manifest *manifest, uint32_t kind, const char *name)
+{
+   assert(manifest && name);
+
+   uint32_t lo = 0, hi = manifest->num_entries;
+   while (lo < hi) {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (entry_cmp(kind, name, &manifest->entries[mid]) > 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return lo;
+}
+
+const struct manifest_entry*
+manifest_find(const struct manifest *manifest, uint32_t kind, const char *name)
+{
+   assert(manifest && name);
+   const uint32_t i = lower_bound(manifest, kind, name);
+   return (i < manifest->num_entries && !entry_cmp(kind, name, &manifest->entries[i]) ? &manifest->entries[i] : NULL);
+}
+
+bool
+manifest_set(struct manifest *manifest, uint32_t kind, const char *name, uint64_t hash)
+{
+   assert(manifest && name);
+
+   const uint32_t i = lower_bound(manifest, kind, name);
+   if (i < manifest->num_entries && !entry_cmp(kind, name, &manifest->entries[i])) {
+      manifest->entries[i].hash = hash;
+      return true;
+   }
+
+   if (manifest->num_entries >= manifest->mem_entries) {
+      const uint32_t mem = (manifest->mem_entries ? manifest->mem_entries * 2 : 64);
+      struct manifest_entry *entries;
+      if (!(entries = realloc(manifest->entries, mem * sizeof(struct manifest_entry))))
+         return false;
+
+      manifest->entries = entries;
+      manifest->mem_entries = mem;
+   }
+
+   char *copy;
+   if (!(copy = strdup(name)))
+      return false;
+
+   memmove(&manifest->entries[i + 1], &manifest->entries[i], (manifest->num_entries - i) * sizeof(struct manifest_entry));
+   manifest->entries[i] = (struct manifest_entry){ .hash = hash, .kind = kind, .name = copy };
+   manifest->num_entries++;
+   return true;
+}
+
+void
+manifest_remove(struct manifest *manifest, uint32_t kind, const char *name)
+{
+   assert(manifest && name);
+
+   const uint32_t i = lower_bound(manifest, kind, name);
+   if (i >= manifest->num_entries || entry_cmp(kind, name, &manifest->entries[i]))
+      return;
+
+   free(manifest->entries[i].name);
+   memmove(&manifest->entries[i], &manifest->entries[i + 1], (manifest->num_entries - i - 1) * sizeof(struct manifest_entry));
+   manifest->num_entries--;
+}
+
+void
+manifest_release(struct manifest *manifest)
+{
+   assert(manifest);
+
+   for (uint32_t i = 0; i < manifest->num_entries; ++i)
+      free(manifest->entries[i].name);
+
+   free(manifest->entries);
+   memset(manifest, 0, sizeof(struct manifest));
+}
+
+bool
+manifest_load(struct manifest *manifest, const char *path, uint64_t options)
+{
+   assert(manifest && path);
+   memset(manifest, 0, sizeof(struct manifest));
+   manifest->options = options;
+
+   FILE *f;
+   if (!(f = fopen(path, "r")))
+      return true;
+
+   char line[1024];
+   uint64_t stored;
+   if (!fgets(line, sizeof(line), f) || sscanf(line, MANIFEST_MAGIC " %" SCNx64, &stored) != 1 || stored != options) {
+      fclose(f);
+      return true;
+   }
+
+   bool ret = true;
+   while (ret && fgets(line, sizeof(line), f)) {
+      line[strcspn(line, "\r\n")] = 0;
+
+      uint64_t hash;
+      uint32_t kind;
+      int name = 0;
+      if (sscanf(line, "%" SCNx64 " %" SCNu32 " %n", &hash, &kind, &name) != 2 || !line[name])
+         continue;
+
+      ret = manifest_set(manifest, kind, line + name, hash);
+   }
+
+   fclose(f);
+   return ret;
+}
+
+bool
+manifest_save(const struct manifest *manifest, const char *path)
+{
+   assert(manifest && path);
+
+   char tmp[1024];
+   if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+      return false;
+
+   FILE *f;
+   if (!(f = fopen(tmp, "w")))
+      return false;
+
+   fprintf(f, MANIFEST_MAGIC " %016" PRIx64 "\n", manifest->options);
+   for (uint32_t i = 0; i < manifest->num_entries; ++i) {
+      const struct manifest_entry *e = &manifest->entries[i];
+      if (!strpbrk(e->name, "\r\n"))
+         fprintf(f, "%016" PRIx64 " %" PRIu32 " %s\n", e->hash, e->kind, e->name);
+   }
+
+   const bool failed = ferror(f);
+   if (fclose(f) != 0 || failed || rename(tmp, path) != 0) {
+      remove(tmp);
+      return false;
+   }
+
+   return true;
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,39 @@
+#ifndef __guhck_manifest__
+#define __guhck_manifest__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Hashes of the chunks behind each exported asset of one output directory.
+ * Assets are keyed by kind (ccs_filter_kind) and name.
+ */
+struct manifest_entry {
+   uint64_t hash;
+   uint32_t kind;
+   char *name;
+};
+
+struct manifest {
+   uint64_t options; // hash of the export options the entries were written with
+   struct manifest_entry *entries; // sorted by kind and name
+   uint32_t num_entries, mem_entries;
+};
+
+/**
+ * Load manifest at path.
+ * Missing files and ones written with different options load as empty.
+ */
+bool manifest_load(struct manifest *manifest, const char *path, uint64_t options);
+
+/** Write manifest, replacing the old one atomically. */
+bool manifest_save(const struct manifest *manifest, const char *path);
+
+const struct manifest_entry* manifest_find(const struct manifest *manifest, uint32_t kind, const char *name);
+bool manifest_set(struct manifest *manifest, uint32_t kind, const char *name, uint64_t hash);
+void manifest_remove(struct manifest *manifest, uint32_t kind, const char *name);
+void manifest_release(struct manifest *manifest);
+
+#endif /* __guhck_manifest__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
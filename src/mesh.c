@@ -0,0 +1,345 @@
+#include "mesh.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#define CACHE_SIZE 32
+
+struct vertex_key {
+   float v[5]; // xyz uv
+};
+
+static uint32_t
+hash_key(const struct vertex_key *key)
+{
+   // FNV-1a over the bit patterns
+   const uint8_t *p = (const uint8_t*)key;
+   uint32_t h = 2166136261u;
+   for (size_t i = 0; i < sizeof(struct vertex_key); ++i)
+      h = (h ^ p[i]) * 16777619u;
+   return h;
+}
+
+static bool
+push_triangle(uint32_t **tris, uint32_t *num, uint32_t *mem, uint32_t a, uint32_t b, uint32_t c)
+{
+   if (*num >= *mem) {
+      const uint32_t next = (*mem ? *mem * 2 : 64);
+      uint32_t *tmp;
+      if (!(tmp = realloc(*tris, next * 3 * sizeof(uint32_t))))
+         return false;
+      *tris = tmp;
+      *mem = next;
+   }
+
+   (*tris)[*num * 3 + 0] = a;
+   (*tris)[*num * 3 + 1] = b;
+   (*tris)[*num * 3 + 2] = c;
+   ++*num;
+   return true;
+}
+
+static bool
+same_position(const float *positions, uint32_t a, uint32_t b)
+{
+   return !memcmp(positions + a * 3, positions + b * 3, 3 * sizeof(float));
+}
+
+bool
+trimesh_from_strips(struct trimesh *mesh, const float *positions, const float *coords, const uint32_t *flags, uint32_t num_vertices)
+{
+   assert(mesh && ((positions && coords && flags) || !num_vertices));
+   memset(mesh, 0, sizeof(struct trimesh));
+
+   uint32_t *tris = NULL, num_tris = 0, mem_tris = 0;
+
+   // non-zero flag starts a strip, the next vertex always belongs to it
+   for (uint32_t i = 0; i < num_vertices;) {
+      if (!flags[i]) {
+         ++i;
+         continue;
+      }
+
+      const uint32_t start = i, type = flags[i];
+      uint32_t end = (i + 2 < num_vertices ? i + 2 : num_vertices);
+      while (end < num_vertices && !flags[end])
+         ++end;
+      i = end;
+
+      if (type != 1 && type != 2) {
+         mesh->num_skipped_strips++;
+         continue;
+      }
+
+      for (uint32_t t = start; t + 2 < end; ++t) {
+         // winding alternates along the strip, type 2 starts the other way around
+         const bool flip = (((t - start) & 1) != (type == 2));
+         const uint32_t a = (flip ? t + 1 : t), b = (flip ? t : t + 1), c = t + 2;
+
+         if (same_position(positions, a, b) || same_position(positions, b, c) || same_position(positions, a, c)) {
+            mesh->num_degenerate++;
+            continue;
+         }
+
+         if (!push_triangle(&tris, &num_tris, &mem_tris, a, b, c))
+            goto fail;
+      }
+   }
+
+   if (!num_tris)
+      return true;
+
+   // deduplicate vertices referenced by the triangles
+   uint32_t size = 16;
+   while (size < num_vertices * 2)
+      size *= 2;
+
+   uint32_t *table = NULL, *remap = NULL;
+   if (!(table = malloc(size * sizeof(uint32_t))) || !(remap = malloc(num_vertices * sizeof(uint32_t))) ||
+       !(mesh->positions = malloc(num_vertices * 3 * sizeof(float))) || !(mesh->coords = malloc(num_vertices * 2 * sizeof(float)))) {
+      free(table);
+      free(remap);
+      goto fail;
+   }
+
+   memset(table, 0xff, size * sizeof(uint32_t));
+   memset(remap, 0xff, num_vertices * sizeof(uint32_t));
+
+   for (uint32_t i = 0; i < num_tris * 3; ++i) {
+      const uint32_t src = tris[i];
+      if (remap[src] == UINT32_MAX) {
+         struct vertex_key key;
+         memcpy(key.v, positions + src * 3, 3 * sizeof(float));
+         memcpy(key.v + 3, coords + src * 2, 2 * sizeof(float));
+
+         uint32_t h = hash_key(&key) & (size - 1);
+         while (table[h] != UINT32_MAX) {
+            const uint32_t v = table[h];
+            if (!memcmp(mesh->positions + v * 3, key.v, 3 * sizeof(float)) && !memcmp(mesh->coords + v * 2, key.v + 3, 2 * sizeof(float)))
+               break;
+            h = (h + 1) & (size - 1);
+         }
+
+         if (table[h] == UINT32_MAX) {
+            table[h] = mesh->num_vertices;
+            memcpy(mesh->positions + mesh->num_vertices * 3, key.v, 3 * sizeof(float));
+            memcpy(mesh->coords + mesh->num_vertices * 2, key.v + 3, 2 * sizeof(float));
+            mesh->num_vertices++;
+         }
+
+         remap[src] = table[h];
+      }
+
+      tris[i] = remap[src];
+   }
+
+   free(table);
+   free(remap);
+
+   mesh->indices = tris;
+   mesh->num_triangles = num_tris;
+   return true;
+
+fail:
+   free(tris);
+   trimesh_release(mesh);
+   return false;
+}
+
+static float
+vertex_score(int32_t cache_pos, uint32_t active)
+{
+   // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+   if (!active)
+      return -1.0f;
+
+   float score = 0.0f;
+   if (cache_pos >= 0) {
+      if (cache_pos < 3) {
+         score = 0.75f;
+      } else {
+         const float scaler = 1.0f / (CACHE_SIZE - 3);
+         score = powf(1.0f - (cache_pos - 3) * scaler, 1.5f);
+      }
+   }
+
+   return score + 2.0f * powf((float)active, -0.5f);
+}
+
+bool
+trimesh_optimize(struct trimesh *mesh)
+{
+   assert(mesh);
+
+   const uint32_t nv = mesh->num_vertices, nt = mesh->num_triangles;
+   if (nt < 2)
+      return true;
+
+   bool ret = false;
+   uint32_t *offsets = calloc(nv + 1, sizeof(uint32_t)), *active = calloc(nv, sizeof(uint32_t));
+   uint32_t *adjacency = malloc(nt * 3 * sizeof(uint32_t)), *out = malloc(nt * 3 * sizeof(uint32_t));
+   int32_t *cache_pos = malloc(nv * sizeof(int32_t));
+   float *vscore = malloc(nv * sizeof(float)), *tscore = malloc(nt * sizeof(float));
+   bool *added = calloc(nt, sizeof(bool));
+   uint32_t *order = malloc(nv * sizeof(uint32_t));
+   float *positions = malloc(nv * 3 * sizeof(float)), *coords = malloc(nv * 2 * sizeof(float));
+
+   if (!offsets || !active || !adjacency || !out || !cache_pos || !vscore || !tscore || !added || !order || !positions || !coords)
+      goto out;
+
+   // triangles adjacent to each vertex
+   for (uint32_t i = 0; i < nt * 3; ++i)
+      offsets[mesh->indices[i] + 1]++;
+   for (uint32_t v = 0; v < nv; ++v)
+      offsets[v + 1] += offsets[v];
+   for (uint32_t t = 0; t < nt; ++t) {
+      for (uint32_t c = 0; c < 3; ++c) {
+         const uint32_t v = mesh->indices[t * 3 + c];
+         adjacency[offsets[v] + active[v]++] = t;
+      }
+   }
+
+   for (uint32_t v = 0; v < nv; ++v) {
+      cache_pos[v] = -1;
+      vscore[v] = vertex_score(-1, active[v]);
+   }
+
+   for (uint32_t t = 0; t < nt; ++t)
+      tscore[t] = vscore[mesh->indices[t * 3]] + vscore[mesh->indices[t * 3 + 1]] + vscore[mesh->indices[t * 3 + 2]];
+
+   uint32_t cache[CACHE_SIZE + 3], cache_len = 0, scan = 0;
+   int64_t best = -1;
+   for (uint32_t t = 0; t < nt; ++t) {
+      if (best < 0 || tscore[t] > tscore[best])
+         best = t;
+   }
+
+   for (uint32_t emitted = 0; emitted < nt; ++emitted) {
+      if (best < 0) {
+         // nothing adjacent to the cache left, take the next unadded triangle
+         while (added[scan]) ++scan;
+         best = scan;
+      }
+
+      const uint32_t *tri = &mesh->indices[best * 3];
+      memcpy(&out[emitted * 3], tri, 3 * sizeof(uint32_t));
+      added[best] = true;
+
+      // remove the triangle from its vertices' active lists
+      for (uint32_t c = 0; c < 3; ++c) {
+         const uint32_t v = tri[c];
+         uint32_t *adj = &adjacency[offsets[v]];
+         for (uint32_t i = 0; i < active[v]; ++i) {
+            if (adj[i] == (uint32_t)best) {
+               adj[i] = adj[--active[v]];
+               break;
+            }
+         }
+      }
+
+      // move the triangle's vertices to the front of the LRU cache
+      uint32_t next[CACHE_SIZE + 3], next_len = 0;
+      for (uint32_t c = 0; c < 3; ++c)
+         next[next_len++] = tri[c];
+      for (uint32_t i = 0; i < cache_len; ++i) {
+         if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+            next[next_len++] = cache[i];
+      }
+
+      for (uint32_t i = 0; i < next_len; ++i)
+         cache_pos[next[i]] = (i < CACHE_SIZE ? (int32_t)i : -1);
+
+      // rescore everything that was in the cache, including the evicted vertices
+      for (uint32_t i = 0; i < next_len; ++i)
+         vscore[next[i]] = vertex_score(cache_pos[next[i]], active[next[i]]);
+
+      best = -1;
+      for (uint32_t i = 0; i < next_len; ++i) {
+         const uint32_t v = next[i];
+         for (uint32_t a = 0; a < active[v]; ++a) {
+            const uint32_t t = adjacency[offsets[v] + a];
+            tscore[t] = vscore[mesh->indices[t * 3]] + vscore[mesh->indices[t * 3 + 1]] + vscore[mesh->indices[t * 3 + 2]];
+            if (best < 0 || tscore[t] > tscore[best])
+               best = t;
+         }
+      }
+
+      cache_len = (next_len > CACHE_SIZE ? CACHE_SIZE : next_len);
+      memcpy(cache, next, cache_len * sizeof(uint32_t));
+   }
+
+   // vertices in order of first use
+   memset(order, 0xff, nv * sizeof(uint32_t));
+   uint32_t used = 0;
+   for (uint32_t i = 0; i < nt * 3; ++i) {
+      const uint32_t v = out[i];
+      if (order[v] == UINT32_MAX) {
+         order[v] = used;
+         memcpy(positions + used * 3, mesh->positions + v * 3, 3 * sizeof(float));
+         memcpy(coords + used * 2, mesh->coords + v * 2, 2 * sizeof(float));
+         ++used;
+      }
+      out[i] = order[v];
+   }
+
+   free(mesh->indices);
+   free(mesh->positions);
+   free(mesh->coords);
+   mesh->indices = out;
+   mesh->positions = positions;
+   mesh->coords = coords;
+   out = NULL;
+   positions = coords = NULL;
+   ret = true;
+
+out:
+   free(offsets);
+   free(active);
+   free(adjacency);
+   free(out);
+   free(cache_pos);
+   free(vscore);
+   free(tscore);
+   free(added);
+   free(order);
+   free(positions);
+   free(coords);
+   return ret;
+}
+
+float
+trimesh_acmr(const struct trimesh *mesh, uint32_t cache_size)
+{
+   assert(mesh);
+
+   if (!mesh->num_triangles || !cache_size)
+      return 0.0f;
+
+   uint32_t *stamp;
+   if (!(stamp = calloc(mesh->num_vertices, sizeof(uint32_t))))
+      return 0.0f;
+
+   // FIFO cache: a vertex is a hit if it was transformed within the last cache_size misses
+   uint32_t misses = 0;
+   for (uint32_t i = 0; i < mesh->num_triangles * 3; ++i) {
+      const uint32_t v = mesh->indices[i];
+      if (!stamp[v] || misses - stamp[v] + 1 > cache_size)
+         stamp[v] = ++misses;
+   }
+
+   free(stamp);
+   return (float)misses / mesh->num_triangles;
+}
+
+void
+trimesh_release(struct trimesh *mesh)
+{
+   assert(mesh);
+   free(mesh->positions);
+   free(mesh->coords);
+   free(mesh->indices);
+   memset(mesh, 0, sizeof(struct trimesh));
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
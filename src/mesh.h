@@ -0,0 +1,37 @@
+#ifndef __guhck_mesh__
+#define __guhck_mesh__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Indexed triangle list built from CCS triangle strips.
+ * Vertices are deduplicated and ordered by first use.
+ */
+struct trimesh {
+   uint32_t num_vertices, num_triangles;
+   float *positions; // xyz per vertex
+   float *coords; // uv per vertex
+   uint32_t *indices; // 3 per triangle
+   uint32_t num_skipped_strips; // unknown winding
+   uint32_t num_degenerate; // dropped triangles
+};
+
+/**
+ * Build triangle list from strips.
+ * flags holds one strip flag per vertex, non-zero starts a strip with that winding.
+ */
+bool trimesh_from_strips(struct trimesh *mesh, const float *positions, const float *coords, const uint32_t *flags, uint32_t num_vertices);
+
+/** Reorder triangles for post-transform vertex cache locality, then vertices by first use. */
+bool trimesh_optimize(struct trimesh *mesh);
+
+/** Average cache miss ratio (transformed vertices per triangle) of a FIFO cache. */
+float trimesh_acmr(const struct trimesh *mesh, uint32_t cache_size);
+
+void trimesh_release(struct trimesh *mesh);
+
+#endif /* __guhck_mesh__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,531 @@
+#define _GNU_SOURCE
+#include "output.h"
+#include "tar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(GUHCK_IO_URING)
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif
+
+// files in flight at once, bounds the encoded buffers held
+#define OUTPUT_DEPTH 64
+
+enum {
+   OP_OPEN,
+   OP_WRITE,
+   OP_CLOSE,
+   NUM_OPS,
+};
+
+struct output_file {
+   char *path;
+   void *data;
+   uint32_t size;
+   uint32_t pending; // completions still to come
+   int error; // first failure as negative errno
+};
+
+#if defined(GUHCK_IO_URING)
+struct ring {
+   int fd;
+   void *sq_map, *cq_map;
+   size_t sq_map_size, cq_map_size;
+   struct io_uring_sqe *sqes;
+   uint32_t num_sqes;
+   uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array;
+   uint32_t *cq_head, *cq_tail, *cq_mask;
+   struct io_uring_cqe *cqes;
+   uint32_t tail, queued; // sqes written and the ones not submitted yet
+};
+#endif
+
+struct output {
+   pthread_mutex_t mutex;
+   enum output_backend backend;
+   struct tar *tar; // shared with the outputs of other archives
+   uint64_t bytes;
+   uint32_t failed;
+#if defined(GUHCK_IO_URING)
+   struct ring ring;
+   pthread_t thread; // the only one entering the ring, requests die with the thread that submitted them
+   pthread_cond_t wake, done;
+   struct output_file files[OUTPUT_DEPTH]; // index is the registered file slot
+   uint32_t free_files[OUTPUT_DEPTH], num_free;
+   uint32_t queued[OUTPUT_DEPTH], num_queued; // claimed by writers, not in the ring yet
+   bool broken, quit;
+#endif
+};
+
+static bool
+write_file(const char *path, const void *data, size_t size)
+{
+   assert(path && (data || !size));
+
+   int fd;
+   if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+      return false;
+
+   bool ret = true;
+   for (size_t off = 0; ret && off < size;) {
+      const ssize_t written = pwrite(fd, (const uint8_t*)data + off, size - off, off);
+      if (written < 0 && errno == EINTR)
+         continue;
+
+      ret = (written > 0);
+      off += (ret ? (size_t)written : 0);
+   }
+
+   return (close(fd) == 0 && ret);
+}
+
+#if defined(GUHCK_IO_URING)
+
+static bool
+ring_probe(int fd)
+{
+   struct io_uring_probe *probe;
+   const size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+   if (!(probe = calloc(1, size)))
+      return false;
+
+   // opening and closing registered slots came with mkdirat in 5.15, probing cannot see them directly
+   static const uint8_t ops[] = { IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_MKDIRAT };
+
+   bool ret = (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0);
+   for (size_t i = 0; ret && i < sizeof(ops); ++i)
+      ret = (ops[i] < probe->ops_len && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED));
+
+   free(probe);
+   return ret;
+}
+
+static void
+ring_release(struct ring *ring)
+{
+   assert(ring);
+
+   if (ring->sqes)
+      munmap(ring->sqes, ring->num_sqes * sizeof(struct io_uring_sqe));
+   if (ring->cq_map && ring->cq_map != ring->sq_map)
+      munmap(ring->cq_map, ring->cq_map_size);
+   if (ring->sq_map)
+      munmap(ring->sq_map, ring->sq_map_size);
+   if (ring->fd >= 0)
+      close(ring->fd);
+
+   memset(ring, 0, sizeof(struct ring));
+   ring->fd = -1;
+}
+
+static bool
+ring_setup(struct ring *ring, uint32_t entries, uint32_t num_slots)
+{
+   assert(ring);
+
+   memset(ring, 0, sizeof(struct ring));
+
+   struct io_uring_params params;
+   memset(&params, 0, sizeof(params));
+   if ((ring->fd = syscall(__NR_io_uring_setup, entries, &params)) < 0 || !ring_probe(ring->fd))
+      goto fail;
+
+   ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+   ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+   // both rings live in one mapping on most kernels
+   if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      if (ring->cq_map_size > ring->sq_map_size)
+         ring->sq_map_size = ring->cq_map_size;
+      ring->cq_map_size = ring->sq_map_size;
+   }
+
+   void *map;
+   if ((map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+      goto fail;
+
+   ring->sq_map = ring->cq_map = map;
+   if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+      if ((map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING)) == MAP_FAILED) {
+         ring->cq_map = NULL;
+         goto fail;
+      }
+      ring->cq_map = map;
+   }
+
+   if ((map = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES)) == MAP_FAILED)
+      goto fail;
+
+   ring->sqes = map;
+   ring->num_sqes = params.sq_entries;
+
+   uint8_t *sq = ring->sq_map, *cq = ring->cq_map;
+   ring->sq_head = (uint32_t*)(sq + params.sq_off.head);
+   ring->sq_tail = (uint32_t*)(sq + params.sq_off.tail);
+   ring->sq_mask = (uint32_t*)(sq + params.sq_off.ring_mask);
+   ring->sq_array = (uint32_t*)(sq + params.sq_off.array);
+   ring->cq_head = (uint32_t*)(cq + params.cq_off.head);
+   ring->cq_tail = (uint32_t*)(cq + params.cq_off.tail);
+   ring->cq_mask = (uint32_t*)(cq + params.cq_off.ring_mask);
+   ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+   ring->tail = *ring->sq_tail;
+
+   // empty slots files are opened into, writes then skip the fd table
+   int fds[OUTPUT_DEPTH];
+   assert(num_slots <= OUTPUT_DEPTH);
+   for (uint32_t i = 0; i < num_slots; ++i)
+      fds[i] = -1;
+
+   if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, fds, num_slots) != 0)
+      goto fail;
+
+   return true;
+
+fail:
+   ring_release(ring);
+   return false;
+}
+
+static struct io_uring_sqe*
+ring_sqe(struct ring *ring, uint8_t opcode, uint32_t slot, uint32_t op, uint8_t flags)
+{
+   assert(ring);
+
+   const uint32_t index = ring->tail & *ring->sq_mask;
+   struct io_uring_sqe *sqe = &ring->sqes[index];
+   memset(sqe, 0, sizeof(struct io_uring_sqe));
+   sqe->opcode = opcode;
+   sqe->flags = flags;
+   sqe->user_data = (uint64_t)slot * NUM_OPS + op;
+   ring->sq_array[index] = index;
+   ring->tail++;
+   ring->queued++;
+   return sqe;
+}
+
+static bool
+ring_submit(struct ring *ring, uint32_t wait)
+{
+   assert(ring);
+
+   __atomic_store_n(ring->sq_tail, ring->tail, __ATOMIC_RELEASE);
+
+   while (ring->queued || wait) {
+      const int ret = syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait, (wait ? IORING_ENTER_GETEVENTS : 0), NULL, 0);
+      if (ret < 0) {
+         if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            continue;
+         return false;
+      }
+
+      ring->queued -= ret;
+      wait = 0;
+   }
+
+   return true;
+}
+
+static void
+file_done(struct output *output, uint32_t slot)
+{
+   assert(output && slot < OUTPUT_DEPTH);
+   struct output_file *file = &output->files[slot];
+
+   if (file->error) {
+      fprintf(stderr, "-!- %s: %s\n", file->path, strerror(-file->error));
+      output->failed++;
+   } else {
+      output->bytes += file->size;
+   }
+
+   free(file->path);
+   free(file->data);
+   memset(file, 0, sizeof(struct output_file));
+   output->free_files[output->num_free++] = slot;
+}
+
+static void
+reap(struct output *output)
+{
+   assert(output);
+   struct ring *ring = &output->ring;
+
+   uint32_t head = *ring->cq_head;
+   const uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+   for (; head != tail; ++head) {
+      const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+      const uint32_t slot = cqe->user_data / NUM_OPS, op = cqe->user_data % NUM_OPS;
+      struct output_file *file = &output->files[slot];
+      assert(slot < OUTPUT_DEPTH && file->pending);
+
+      // links after a failed open complete as canceled, keep the open error
+      int error = (cqe->res < 0 ? cqe->res : 0);
+      if (op == OP_WRITE && cqe->res >= 0 && (uint32_t)cqe->res != file->size)
+         error = -EIO;
+
+      if (!file->error)
+         file->error = error;
+
+      if (!--file->pending)
+         file_done(output, slot);
+   }
+
+   __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void
+ring_queue(struct ring *ring, uint32_t slot, const struct output_file *file)
+{
+   assert(ring && file);
+
+   // the kernel runs the chain on its own, a failed write still closes the slot
+   struct io_uring_sqe *sqe = ring_sqe(ring, IORING_OP_OPENAT, slot, OP_OPEN, IOSQE_IO_LINK);
+   sqe->fd = AT_FDCWD;
+   sqe->addr = (uintptr_t)file->path;
+   sqe->len = 0644;
+   sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC; // slots never reach the fd table, O_CLOEXEC is refused
+   sqe->file_index = slot + 1;
+
+   sqe = ring_sqe(ring, IORING_OP_WRITE, slot, OP_WRITE, IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK);
+   sqe->fd = slot;
+   sqe->addr = (uintptr_t)file->data;
+   sqe->len = file->size;
+   sqe->off = 0;
+
+   sqe = ring_sqe(ring, IORING_OP_CLOSE, slot, OP_CLOSE, 0);
+   sqe->file_index = slot + 1;
+}
+
+static void*
+ring_thread(void *arg)
+{
+   assert(arg);
+   struct output *output = arg;
+
+   pthread_mutex_lock(&output->mutex);
+   for (;;) {
+      if (!output->num_queued && output->num_free == OUTPUT_DEPTH) {
+         if (output->quit)
+            break;
+
+         pthread_cond_wait(&output->wake, &output->mutex);
+         continue;
+      }
+
+      // whatever was queued while the last batch was in flight goes in as one batch
+      for (uint32_t i = 0; i < output->num_queued; ++i)
+         ring_queue(&output->ring, output->queued[i], &output->files[output->queued[i]]);
+      output->num_queued = 0;
+
+      pthread_mutex_unlock(&output->mutex);
+      const bool ret = ring_submit(&output->ring, 1);
+      pthread_mutex_lock(&output->mutex);
+
+      if (!ret) {
+         // the kernel may still own the buffers in flight, leak them rather than free under it
+         output->failed += OUTPUT_DEPTH - output->num_free;
+         output->broken = true;
+         pthread_cond_broadcast(&output->done);
+         break;
+      }
+
+      reap(output);
+      pthread_cond_broadcast(&output->done);
+   }
+   pthread_mutex_unlock(&output->mutex);
+   return NULL;
+}
+
+static bool
+ring_start(struct output *output)
+{
+   assert(output);
+
+   if (!ring_setup(&output->ring, OUTPUT_DEPTH * NUM_OPS, OUTPUT_DEPTH))
+      return false;
+
+   for (uint32_t i = 0; i < OUTPUT_DEPTH; ++i)
+      output->free_files[i] = OUTPUT_DEPTH - 1 - i;
+   output->num_free = OUTPUT_DEPTH;
+
+   pthread_cond_init(&output->wake, NULL);
+   pthread_cond_init(&output->done, NULL);
+   if (pthread_create(&output->thread, NULL, ring_thread, output) != 0) {
+      pthread_cond_destroy(&output->wake);
+      pthread_cond_destroy(&output->done);
+      ring_release(&output->ring);
+      return false;
+   }
+
+   return true;
+}
+
+static void
+ring_stop(struct output *output)
+{
+   assert(output);
+
+   pthread_mutex_lock(&output->mutex);
+   output->quit = true;
+   pthread_cond_signal(&output->wake);
+   pthread_mutex_unlock(&output->mutex);
+
+   pthread_join(output->thread, NULL);
+   pthread_cond_destroy(&output->wake);
+   pthread_cond_destroy(&output->done);
+   ring_release(&output->ring);
+}
+
+static bool
+queue_file(struct output *output, const char *path, void *data, uint32_t size)
+{
+   assert(output && path);
+
+   // full ring holds writers back, encoded buffers waiting stay bounded
+   while (!output->broken && !output->num_free)
+      pthread_cond_wait(&output->done, &output->mutex);
+
+   char *copy;
+   if (output->broken || !(copy = strdup(path)))
+      return false;
+
+   const uint32_t slot = output->free_files[--output->num_free];
+   output->files[slot] = (struct output_file){ copy, data, size, NUM_OPS, 0 };
+   output->queued[output->num_queued++] = slot;
+   pthread_cond_signal(&output->wake);
+   return true;
+}
+
+#endif /* GUHCK_IO_URING */
+
+struct output*
+output_new(enum output_backend backend)
+{
+   assert(backend != OUTPUT_TAR);
+
+   struct output *output;
+   if (!(output = calloc(1, sizeof(struct output))))
+      return NULL;
+
+   pthread_mutex_init(&output->mutex, NULL);
+   output->backend = OUTPUT_PWRITE;
+
+#if defined(GUHCK_IO_URING)
+   if (backend != OUTPUT_PWRITE && ring_start(output))
+      output->backend = OUTPUT_URING;
+#endif
+
+   if (backend == OUTPUT_URING && output->backend != OUTPUT_URING) {
+      output_free(output);
+      return NULL;
+   }
+
+   return output;
+}
+
+struct output*
+output_new_tar(struct tar *tar)
+{
+   assert(tar);
+
+   struct output *output;
+   if (!(output = calloc(1, sizeof(struct output))))
+      return NULL;
+
+   pthread_mutex_init(&output->mutex, NULL);
+   output->backend = OUTPUT_TAR;
+   output->tar = tar;
+   return output;
+}
+
+void
+output_free(struct output *output)
+{
+   if (!output)
+      return;
+
+   output_flush(output, NULL, NULL);
+
+#if defined(GUHCK_IO_URING)
+   if (output->backend == OUTPUT_URING)
+      ring_stop(output);
+#endif
+
+   pthread_mutex_destroy(&output->mutex);
+   free(output);
+}
+
+const char*
+output_backend_name(const struct output *output)
+{
+   if (output && output->backend == OUTPUT_URING)
+      return "io_uring";
+   return (output && output->backend == OUTPUT_TAR ? "tar" : "pwrite");
+}
+
+bool
+output_write(struct output *output, const char *path, void *data, size_t size)
+{
+   assert(path && (data || !size));
+
+   if (!output) {
+      const bool ret = write_file(path, data, size);
+      free(data);
+      return ret;
+   }
+
+#if defined(GUHCK_IO_URING)
+   if (output->backend == OUTPUT_URING && size <= UINT32_MAX) {
+      pthread_mutex_lock(&output->mutex);
+      const bool ret = queue_file(output, path, data, size);
+      pthread_mutex_unlock(&output->mutex);
+
+      if (!ret)
+         free(data);
+      return ret;
+   }
+#endif
+
+   const bool ret = (output->backend == OUTPUT_TAR ? tar_write(output->tar, path, data, size) : write_file(path, data, size));
+   free(data);
+
+   if (!ret)
+      fprintf(stderr, "-!- %s: %s\n", path, strerror(errno));
+
+   pthread_mutex_lock(&output->mutex);
+   output->bytes += (ret ? size : 0);
+   pthread_mutex_unlock(&output->mutex);
+   return ret;
+}
+
+void
+output_flush(struct output *output, uint64_t *out_bytes, uint32_t *out_failed)
+{
+   assert(output);
+
+   pthread_mutex_lock(&output->mutex);
+
+#if defined(GUHCK_IO_URING)
+   while (output->backend == OUTPUT_URING && !output->broken && output->num_free < OUTPUT_DEPTH)
+      pthread_cond_wait(&output->done, &output->mutex);
+#endif
+
+   if (out_bytes)
+      *out_bytes = output->bytes;
+   if (out_failed)
+      *out_failed = output->failed;
+
+   output->bytes = 0;
+   output->failed = 0;
+   pthread_mutex_unlock(&output->mutex);
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
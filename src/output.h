@@ -0,0 +1,44 @@
+#ifndef __guhck_output__
+#define __guhck_output__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+enum output_backend {
+   OUTPUT_AUTO, // io_uring where the kernel has it, pwrite otherwise
+   OUTPUT_URING,
+   OUTPUT_PWRITE,
+   OUTPUT_TAR, // only from output_new_tar
+};
+
+struct tar;
+
+/**
+ * Sink for finished output files.
+ * The io_uring backend queues each file as one linked open, write and close
+ * and submits them in batches, so encoding carries on while they are written.
+ */
+struct output;
+
+/** NULL if backend is not available or out of memory. */
+struct output* output_new(enum output_backend backend);
+/** Output appending every file to tar instead, tar outlives it. */
+struct output* output_new_tar(struct tar *tar);
+
+void output_free(struct output *output);
+const char* output_backend_name(const struct output *output);
+
+/**
+ * Write size bytes of data to path, taking ownership of data allocated with malloc.
+ * False if the write failed right away, the ones failing later are counted by output_flush.
+ * Safe to call from many threads, a NULL output writes synchronously.
+ */
+bool output_write(struct output *output, const char *path, void *data, size_t size);
+
+/** Wait for every queued write, returns bytes written and queued writes failed since the last flush. */
+void output_flush(struct output *output, uint64_t *out_bytes, uint32_t *out_failed);
+
+#endif /* __guhck_output__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
+#include "store.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+void
+store_key_add(struct store_key *key, const void *data, size_t len)
+{
+   assert(key && (data || !len));
+
+   // two independent 64 bit lanes, a collision would silently swap assets
+   key->hi = hash64(data, len, key->hi);
+   key->lo = hash64(data, len, key->lo ^ 0x9e3779b97f4a7c15ULL);
+}
+
+bool
+store_path(char *path, size_t size, const char *store, const struct store_key *key, const char *ext)
+{
+   assert(path && store && key && ext);
+
+   // fan out by the first byte, keeps directories small for big dumps
+   const int len = snprintf(path, size, "%s/%02x", store, (unsigned)(key->hi >> 56));
+   if (len < 0 || (size_t)len >= size || (mkdir(path, 0755) != 0 && errno != EEXIST))
+      return false;
+
+   const int full = snprintf(path, size, "%s/%02x/%016" PRIx64 "%016" PRIx64 "%s", store, (unsigned)(key->hi >> 56), key->hi, key->lo, ext);
+   return (full >= 0 && (size_t)full < size);
+}
+
+bool
+store_temp(char *tmp, size_t size, const char *path)
+{
+   assert(tmp && path);
+
+   if (snprintf(tmp, size, "%s.XXXXXX", path) >= (int)size)
+      return false;
+
+   int fd;
+   if ((fd = mkstemp(tmp)) < 0)
+      return false;
+
+   close(fd);
+   return true;
+}
+
+bool
+store_commit(const char *tmp, const char *path)
+{
+   assert(tmp && path);
+
+   if (rename(tmp, path) != 0) {
+      remove(tmp);
+      return false;
+   }
+
+   return true;
+}
+
+static bool
+copy_file(const char *src, const char *dst)
+{
+   assert(src && dst);
+
+   FILE *in, *out = NULL;
+   if (!(in = fopen(src, "rb")) || !(out = fopen(dst, "wb"))) {
+      if (in)
+         fclose(in);
+      return false;
+   }
+
+   char buf[64 * 1024];
+   size_t read;
+   bool ret = true;
+   while (ret && (read = fread(buf, 1, sizeof(buf), in)) > 0)
+      ret = (fwrite(buf, 1, read, out) == read);
+
+   ret = ret && !ferror(in);
+   fclose(in);
+   return (fclose(out) == 0 && ret);
+}
+
+bool
+store_link(const char *stored, const char *path)
+{
+   assert(stored && path);
+
+   // replace whatever an earlier run left, the last writer of a name wins
+   if (unlink(path) != 0 && errno != ENOENT)
+      return false;
+
+   if (link(stored, path) == 0)
+      return true;
+
+   // other file system, link limit or no hard links at all
+   return copy_file(stored, path);
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,33 @@
+#ifndef __guhck_store__
+#define __guhck_store__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Content addressed directory of encoded assets, <store>/<xx>/<key><ext>.
+ * Outputs are hard links into it, so identical assets are encoded and stored once.
+ */
+struct store_key {
+   uint64_t hi, lo;
+};
+
+/** Chain len bytes of data into key. */
+void store_key_add(struct store_key *key, const void *data, size_t len);
+
+/** Path of key with extension ext, creating its fan-out directory. */
+bool store_path(char *path, size_t size, const char *store, const struct store_key *key, const char *ext);
+
+/** Create a unique empty file next to path, outputs are encoded to it plus an extension. */
+bool store_temp(char *tmp, size_t size, const char *path);
+
+/** Move tmp to path atomically, racing writers of one key write the same bytes. */
+bool store_commit(const char *tmp, const char *path);
+
+/** Make path refer to stored, with a hard link or a copy where linking fails. */
+bool store_link(const char *stored, const char *path);
+
+#endif /* __guhck_store__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
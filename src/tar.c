@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+#include "tar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#define TAR_BLOCK 512
+#define TAR_MAX_SIZE 077777777777ULL // 11 octal digits of the size field
+
+struct tar {
+   pthread_mutex_t mutex;
+   int fd;
+   uint64_t mtime; // every member is stamped with the time the stream was opened
+   bool broken;
+};
+
+struct tar_header {
+   char name[100], mode[8], uid[8], gid[8], size[12], mtime[12], chksum[8], typeflag;
+   char linkname[100], magic[6], version[2], uname[32], gname[32], devmajor[8], devminor[8], prefix[155], pad[12];
+};
+
+static const uint8_t zeros[TAR_BLOCK * 2];
+
+static size_t
+padding(size_t size)
+{
+   return (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+}
+
+static void
+octal(char *field, size_t size, uint64_t value)
+{
+   assert(field && size > 1);
+   snprintf(field, size, "%0*" PRIo64, (int)size - 1, value);
+}
+
+static bool
+header_name(struct tar_header *header, const char *path, size_t len)
+{
+   assert(header && path);
+
+   if (len <= sizeof(header->name)) {
+      memcpy(header->name, path, len);
+      return true;
+   }
+
+   // ustar splits longer names at a slash into prefix and name
+   const size_t first = (len > sizeof(header->name) + 1 ? len - sizeof(header->name) - 1 : 1);
+   for (size_t i = first; i <= sizeof(header->prefix) && i + 1 < len; ++i) {
+      if (path[i] != '/')
+         continue;
+
+      memcpy(header->prefix, path, i);
+      memcpy(header->name, path + i + 1, len - i - 1);
+      return true;
+   }
+
+   // truncated, the pax header in front carries the full name
+   memcpy(header->name, path, sizeof(header->name));
+   return false;
+}
+
+static bool
+header_init(struct tar_header *header, const char *path, size_t len, uint64_t size, char type, uint64_t mtime)
+{
+   assert(header && path);
+
+   memset(header, 0, sizeof(struct tar_header));
+   const bool fits = header_name(header, path, len);
+
+   octal(header->mode, sizeof(header->mode), 0644);
+   octal(header->uid, sizeof(header->uid), 0);
+   octal(header->gid, sizeof(header->gid), 0);
+   octal(header->size, sizeof(header->size), size);
+   octal(header->mtime, sizeof(header->mtime), mtime);
+   header->typeflag = type;
+   memcpy(header->magic, "ustar", 6);
+   memcpy(header->version, "00", 2);
+
+   // checksum is summed with its own field as spaces
+   memset(header->chksum, ' ', sizeof(header->chksum));
+   uint32_t sum = 0;
+   for (size_t i = 0; i < sizeof(struct tar_header); ++i)
+      sum += ((const uint8_t*)header)[i];
+
+   snprintf(header->chksum, sizeof(header->chksum), "%06o", (unsigned)sum);
+   header->chksum[7] = ' ';
+   return fits;
+}
+
+static size_t
+digits(size_t value)
+{
+   size_t ret = 1;
+   for (; value >= 10; value /= 10)
+      ++ret;
+   return ret;
+}
+
+static bool
+write_all(int fd, struct iovec *iov, int count)
+{
+   assert(iov);
+
+   while (count > 0) {
+      const ssize_t written = writev(fd, iov, count);
+      if (written < 0 && errno == EINTR)
+         continue;
+
+      if (written <= 0)
+         return false;
+
+      size_t left = written;
+      for (; count > 0 && left >= iov->iov_len; ++iov, --count)
+         left -= iov->iov_len;
+
+      if (count > 0) {
+         iov->iov_base = (uint8_t*)iov->iov_base + left;
+         iov->iov_len -= left;
+      }
+   }
+
+   return true;
+}
+
+struct tar*
+tar_open(int fd)
+{
+   struct tar *tar;
+   if (!(tar = calloc(1, sizeof(struct tar))))
+      return NULL;
+
+   pthread_mutex_init(&tar->mutex, NULL);
+   tar->fd = fd;
+   tar->mtime = (uint64_t)time(NULL);
+   return tar;
+}
+
+bool
+tar_write(struct tar *tar, const char *path, const void *data, size_t size)
+{
+   assert(tar && path && (data || !size));
+   assert(sizeof(struct tar_header) == TAR_BLOCK);
+
+   // members are relative to wherever the stream is unpacked
+   for (;;) {
+      if (*path == '/')
+         ++path;
+      else if (!strncmp(path, "./", 2))
+         path += 2;
+      else
+         break;
+   }
+
+   const size_t len = strlen(path);
+   if (!len || size > TAR_MAX_SIZE) {
+      errno = (len ? EFBIG : EINVAL);
+      return false;
+   }
+
+   // record is "<length> path=<path>\n", its length counting its own digits
+   const size_t base = strlen(" path=") + len + 1;
+   size_t record = base + digits(base);
+   while (record != base + digits(record))
+      record = base + digits(record);
+
+   // pax header and record go in front of the ustar header when the name needs them
+   uint8_t *head;
+   const size_t pax_size = TAR_BLOCK + record + padding(record);
+   if (!(head = calloc(1, pax_size + TAR_BLOCK)))
+      return false;
+
+   struct iovec iov[3] = {
+      { head + pax_size, TAR_BLOCK },
+      { (void*)data, size },
+      { (void*)zeros, padding(size) },
+   };
+
+   if (!header_init((struct tar_header*)(head + pax_size), path, len, size, '0', tar->mtime)) {
+      header_init((struct tar_header*)head, "././@PaxHeader", strlen("././@PaxHeader"), record, 'x', tar->mtime);
+      snprintf((char*)head + TAR_BLOCK, record + 1, "%zu path=%s\n", record, path);
+      iov[0] = (struct iovec){ head, pax_size + TAR_BLOCK };
+   }
+
+   pthread_mutex_lock(&tar->mutex);
+   bool ret = false;
+   if (tar->broken)
+      errno = EIO;
+   else if (!(ret = write_all(tar->fd, iov, 3)))
+      tar->broken = true; // a member cut short throws every later one out of place
+   pthread_mutex_unlock(&tar->mutex);
+
+   free(head);
+   return ret;
+}
+
+bool
+tar_close(struct tar *tar)
+{
+   assert(tar);
+
+   struct iovec iov = { (void*)zeros, sizeof(zeros) };
+   const bool ret = (!tar->broken && write_all(tar->fd, &iov, 1));
+
+   pthread_mutex_destroy(&tar->mutex);
+   const bool closed = (close(tar->fd) == 0);
+   free(tar);
+   return (closed && ret);
+}
+
+/* vim: set ts=8 sw=3 tw=0 :*/
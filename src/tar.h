@@ -0,0 +1,28 @@
+#ifndef __guhck_tar__
+#define __guhck_tar__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * POSIX tar stream written sequentially to one file descriptor.
+ * Names that do not fit ustar get a pax extended header.
+ */
+struct tar;
+
+/** Take ownership of fd, NULL if out of memory. */
+struct tar* tar_open(int fd);
+
+/**
+ * Append path with size bytes of data as one member.
+ * Safe to call from many threads, members are never interleaved.
+ * Once a write fails the stream is broken and every later one fails too.
+ */
+bool tar_write(struct tar *tar, const char *path, const void *data, size_t size);
+
+/** Write the end of archive, close and free, false if any write failed. */
+bool tar_close(struct tar *tar);
+
+#endif /* __guhck_tar__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/
@@ -0,0 +1,81 @@
+#ifndef __guhck_view__
+#define __guhck_view__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/**
+ * Zero-copy little-endian reader over a range of the archive.
+ * Bounds are validated up front with view_has, the loads after that are unchecked.
+ */
+struct view {
+   const uint8_t *data;
+   size_t size, pos;
+};
+
+/** View size bytes at offset of data, false if they run past data_size. */
+static inline bool
+view_init(struct view *view, const void *data, size_t data_size, size_t offset, size_t size)
+{
+   assert(view && (data || !data_size));
+
+   if (offset > data_size || size > data_size - offset)
+      return false;
+
+   *view = (struct view){ (const uint8_t*)data + offset, size, 0 };
+   return true;
+}
+
+static inline size_t
+view_left(const struct view *view)
+{
+   return view->size - view->pos;
+}
+
+static inline bool
+view_has(const struct view *view, size_t bytes)
+{
+   return bytes <= view_left(view);
+}
+
+static inline const uint8_t*
+view_ptr(const struct view *view)
+{
+   return view->data + view->pos;
+}
+
+static inline void
+view_seek(struct view *view, size_t pos)
+{
+   assert(pos <= view->size);
+   view->pos = pos;
+}
+
+static inline void
+view_skip(struct view *view, size_t bytes)
+{
+   assert(view_has(view, bytes));
+   view->pos += bytes;
+}
+
+static inline uint8_t
+view_u8(struct view *view)
+{
+   assert(view_has(view, 1));
+   return view->data[view->pos++];
+}
+
+static inline uint32_t
+view_u32(struct view *view)
+{
+   assert(view_has(view, 4));
+   const uint8_t *p = view->data + view->pos;
+   view->pos += 4;
+   return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+#endif /* __guhck_view__ */
+
+/* vim: set ts=8 sw=3 tw=0 :*/